@@ -44,8 +44,8 @@ int main() {
 	glEnable(GL_DEPTH_TEST); // Depth testing
 
 	// Textures
-	GLuint buildingTexture = ew::loadTexture("assets/Building_Color.png");
-	GLuint normalTexture = ew::loadTexture("assets/Building_NormalGL.png");
+	GLuint buildingTexture = ew::loadTextureAsync("assets/Building_Color.png");
+	GLuint normalTexture = ew::loadTextureAsync("assets/Building_NormalGL.png", ew::TEXTURE_PLACEHOLDER_NORMAL);
 
 	// Models
 	ew::Model monkeyModel = ew::Model("assets/suzanne.fbx");
@@ -65,6 +65,7 @@ int main() {
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		ew::updateTextureLoads();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
@@ -102,10 +102,10 @@ int main() {
 	}
 
 	// Textures
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
-	GLuint defaultNormalTexture = ew::loadTexture("assets/Default_normal.jpg");
-	GLuint buildingTexture = ew::loadTexture("assets/Building_Color.png");
-	GLuint normalTexture = ew::loadTexture("assets/Building_NormalGL.png");
+	GLuint brickTexture = ew::loadTextureAsync("assets/brick_color.jpg");
+	GLuint defaultNormalTexture = ew::loadTextureAsync("assets/Default_normal.jpg", ew::TEXTURE_PLACEHOLDER_NORMAL);
+	GLuint buildingTexture = ew::loadTextureAsync("assets/Building_Color.png");
+	GLuint normalTexture = ew::loadTextureAsync("assets/Building_NormalGL.png", ew::TEXTURE_PLACEHOLDER_NORMAL);
 
 	// Models & Meshes
 	ew::Model monkeyModel = ew::Model("assets/suzanne.fbx");
@@ -131,6 +131,7 @@ int main() {
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		ew::updateTextureLoads();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
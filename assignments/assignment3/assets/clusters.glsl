@@ -0,0 +1,63 @@
+// Clustered light lists, built by lightCulling.comp and read by the lighting pass.
+// Cluster math must match nb::getClusterBounds; uniforms are set by nb::setLightClusterUniforms.
+
+// Matches nb::CLUSTER_MAX_LIGHTS
+#define CLUSTER_MAX_LIGHTS 256
+
+#ifdef CLUSTER_WRITE
+#define CLUSTER_ACCESS
+#else
+#define CLUSTER_ACCESS readonly
+#endif
+
+uniform int _ClusterDimX;
+uniform int _ClusterDimY;
+uniform int _ClusterDimZ;
+uniform float _ClusterNear;
+uniform float _ClusterFar;
+uniform mat4 _ClusterView;
+uniform mat4 _ClusterInverseProjection;
+
+// Header padded to 16 bytes, nb::LIGHT_CLUSTER_HEADER_SIZE
+layout(std430, binding = 3) CLUSTER_ACCESS buffer ClusterGrid {
+	uint _TotalClusterIndices;
+	uint _ClusterPadding[3];
+	uvec2 _Clusters[]; // {offset, count} into _ClusterLightIndices
+};
+layout(std430, binding = 4) CLUSTER_ACCESS buffer ClusterIndices {
+	uint _ClusterLightIndices[];
+};
+
+// Exponential slices; slice 0 also covers everything closer than _ClusterNear
+float getClusterSliceDepth(int slice) {
+	return slice == 0 ? 0.0 : _ClusterNear * pow(_ClusterFar / _ClusterNear, float(slice) / float(_ClusterDimZ));
+}
+
+// screenUV is 0-1 across the viewport
+uint getClusterIndex(vec2 screenUV, vec3 worldPos) {
+	float depth = -(_ClusterView * vec4(worldPos, 1.0)).z;
+	int slice = depth <= _ClusterNear ? 0 : int(log(depth / _ClusterNear) / log(_ClusterFar / _ClusterNear) * float(_ClusterDimZ));
+	ivec3 cluster = clamp(ivec3(ivec2(screenUV * vec2(_ClusterDimX, _ClusterDimY)), slice), ivec3(0), ivec3(_ClusterDimX, _ClusterDimY, _ClusterDimZ) - 1);
+	return uint(cluster.x + (cluster.y + cluster.z * _ClusterDimY) * _ClusterDimX);
+}
+
+// View space bounding box of a cluster
+void getClusterBounds(uint cluster, out vec3 boundsMin, out vec3 boundsMax) {
+	int x = int(cluster) % _ClusterDimX;
+	int y = (int(cluster) / _ClusterDimX) % _ClusterDimY;
+	int z = int(cluster) / (_ClusterDimX * _ClusterDimY);
+	float depths[2] = float[2](getClusterSliceDepth(z), getClusterSliceDepth(z + 1));
+	boundsMin = vec3(1e30);
+	boundsMax = vec3(-1e30);
+	for (int corner = 0; corner < 4; corner++) {
+		vec2 ndc = vec2(float(x + (corner & 1)) / float(_ClusterDimX), float(y + (corner >> 1)) / float(_ClusterDimY)) * 2.0 - 1.0;
+		// Ray through the tile corner, scaled to unit view depth
+		vec4 point = _ClusterInverseProjection * vec4(ndc, -1.0, 1.0);
+		vec3 ray = point.xyz / point.w;
+		ray /= -ray.z;
+		for (int d = 0; d < 2; d++) {
+			boundsMin = min(boundsMin, ray * depths[d]);
+			boundsMax = max(boundsMax, ray * depths[d]);
+		}
+	}
+}
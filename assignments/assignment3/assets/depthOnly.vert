@@ -2,9 +2,15 @@
 
 layout (location = 0) in vec3 vPos;
 
+#include "drawObjects.glsl"
+
 uniform mat4 _ViewProjection;
-uniform mat4 _Model;
 
 void main() {
-	gl_Position = _ViewProjection * _Model * vec4(vPos, 1.0);
+#ifdef CASCADED
+	// World space; shadowCascades.geom projects into each cascade
+	gl_Position = _Objects[vObjectIndex].model * vec4(vPos, 1.0);
+#else
+	gl_Position = _ViewProjection * _Objects[vObjectIndex].model * vec4(vPos, 1.0);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+// Per-object data for meshes drawn through ew::DrawQueue. Each indirect command's baseInstance
+// selects its object through the geometry arena's object index attribute.
+layout(location = 4) in uint vObjectIndex;
+
+struct ObjectData {
+	mat4 model;
+	vec4 color;
+};
+layout(std430, binding = 2) readonly buffer ObjectBuffer {
+	ObjectData _Objects[];
+};
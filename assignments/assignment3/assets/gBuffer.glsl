@@ -0,0 +1,59 @@
+// Gbuffer encoding, matching nb::GBufferLayout.
+// Wide: world position, world normal, albedo.
+// Compact: depth only (position rebuilt with _InverseViewProjection), octahedral normal in RG16, albedo in RGBA8
+// with a packed material parameter in alpha.
+#ifndef COMPACT_GBUFFER
+#define COMPACT_GBUFFER 0
+#endif
+
+// Octahedral mapping: the unit sphere folded onto a square, so two channels hold a normal with even precision
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+#ifdef GBUFFER_READ
+uniform layout(binding = 0) sampler2D _gPositions; // Depth in the compact layout
+uniform layout(binding = 1) sampler2D _gNormals;
+uniform layout(binding = 2) sampler2D _gAlbedo;
+uniform mat4 _InverseViewProjection;
+
+struct GBufferSurface {
+	vec3 worldPos;
+	vec3 normal;
+	vec3 albedo;
+	float material; // Packed material parameter, 1 in the wide layout
+};
+
+// Gbuffers are screen sized, so a fragment reads its own texel
+GBufferSurface readGBuffer(ivec2 texel) {
+	GBufferSurface surface;
+#if COMPACT_GBUFFER
+	float depth = texelFetch(_gPositions, texel, 0).r;
+	vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(_gPositions, 0));
+	vec4 position = _InverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	surface.worldPos = position.xyz / position.w;
+	surface.normal = decodeNormal(texelFetch(_gNormals, texel, 0).rg);
+	vec4 albedo = texelFetch(_gAlbedo, texel, 0);
+	surface.albedo = albedo.rgb;
+	surface.material = albedo.a;
+#else
+	surface.worldPos = texelFetch(_gPositions, texel, 0).xyz;
+	surface.normal = texelFetch(_gNormals, texel, 0).xyz;
+	surface.albedo = texelFetch(_gAlbedo, texel, 0).rgb;
+	surface.material = 1.0;
+#endif
+	return surface;
+}
+#endif
@@ -1,8 +1,15 @@
 #version 450 core
 
+#include "gBuffer.glsl"
+
+#if COMPACT_GBUFFER
+layout(location = 0) out vec2 gNormal; // Octahedral worldspace normal
+layout(location = 1) out vec4 gAlbedo; // Alpha: packed material parameter
+#else
 layout(location = 0) out vec3 gPosition; // Worldspace position
 layout(location = 1) out vec3 gNormal; // Worldspace normal
 layout(location = 2) out vec3 gAlbedo;
+#endif
 
 in Surface {
 	vec3 WorldPos;
@@ -18,12 +25,18 @@ vec3 normal;
 
 
 void main() {
-	gPosition = fs_in.WorldPos;
-
-	normal = texture(_NormalTex, fs_in.TexCoord).rgb;
-	normal = normal * 2.0 - 1.0;
+	//Only xy is stored (BC5 normal maps), so rebuild z
+	normal.xy = texture(_NormalTex, fs_in.TexCoord).rg * 2.0 - 1.0;
+	normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 	normal = normalize(fs_in.TBN * normal);
 
+#if COMPACT_GBUFFER
+	// Position comes back from the depth buffer
+	gNormal = encodeNormal(normalize(fs_in.WorldNormal));
+	gAlbedo = vec4(texture(_MainTex, fs_in.TexCoord).rgb, 1.0);
+#else
+	gPosition = fs_in.WorldPos;
 	gNormal = normalize(fs_in.WorldNormal);
 	gAlbedo = texture(_MainTex, fs_in.TexCoord).rgb;
+#endif
 }
\ No newline at end of file
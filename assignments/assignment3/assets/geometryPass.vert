@@ -6,7 +6,8 @@ layout(location = 1) in vec3 vNormal; // Vertex position in model space
 layout(location = 2) in vec3 vTangent; // Tangent
 layout(location = 3) in vec2 vTexCoord; // Vertex texture coordinate (UV)
 
-uniform mat4 _Model; // Model -> World Matrix
+#include "drawObjects.glsl"
+
 uniform mat4 _ViewProjection; // Combined View -> Projection Matrix
 
 out Surface {
@@ -18,6 +19,8 @@ out Surface {
 
 
 void main() {
+	mat4 _Model = _Objects[vObjectIndex].model; // Model -> World Matrix
+
 	// Transform vertex position to World Space
 	vs_out.WorldPos = vec3(_Model * vec4(vPos, 1.0));
 
@@ -2,10 +2,18 @@
 
 out vec4 FragColor;
 
+#ifdef INSTANCED
+flat in vec3 vs_Color;
+#else
 uniform vec3 _Color;
+#endif
 
 void main() {
 
+#ifdef INSTANCED
+	FragColor = vec4(vs_Color, 1.0);
+#else
 	FragColor = vec4(_Color, 1.0);
+#endif
 
-}
\ No newline at end of file
+}
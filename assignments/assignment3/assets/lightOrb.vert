@@ -2,11 +2,29 @@
 
 layout(location = 0) in vec3 vPos;
 
-uniform mat4 _Model;
 uniform mat4 _ViewProjection;
 
+// INSTANCED reads each orb's transform and color from a storage buffer instead of per draw uniforms
+#ifdef INSTANCED
+struct InstanceData {
+	mat4 model;
+	vec4 color;
+};
+layout(std430, binding = 1) readonly buffer InstanceBuffer {
+	InstanceData _Instances[];
+};
+flat out vec3 vs_Color;
+#else
+uniform mat4 _Model;
+#endif
+
 void main() {
 
+#ifdef INSTANCED
+	vs_Color = _Instances[gl_InstanceID].color.rgb;
+	gl_Position = _ViewProjection * _Instances[gl_InstanceID].model * vec4(vPos, 1.0);
+#else
 	gl_Position = _ViewProjection * _Model * vec4(vPos, 1.0);
+#endif
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,16 @@
+#version 450 core
+
+#include "pointLights.glsl"
+#include "pointLighting.glsl"
+#define GBUFFER_READ
+#include "gBuffer.glsl"
+
+// One point light's contribution, blended additively over the directional light pass
+out vec4 FragColor;
+
+flat in uint vs_LightIndex;
+
+void main() {
+	GBufferSurface surface = readGBuffer(ivec2(gl_FragCoord.xy));
+	FragColor = vec4(surface.albedo * calcPointLight(_PointLights[vs_LightIndex], surface.normal, surface.worldPos), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 450 core
+
+#include "pointLights.glsl"
+
+// Unit sphere scaled to each light's radius, one instance per light
+layout(location = 0) in vec3 vPos;
+
+uniform mat4 _ViewProjection;
+uniform int _FirstLight; // Added to gl_InstanceID; the stencil path draws one light at a time
+uniform float _VolumeScale; // Pushes the tessellated faces out so they cover the whole radius
+
+flat out uint vs_LightIndex;
+
+void main() {
+	vs_LightIndex = uint(_FirstLight + gl_InstanceID);
+	PointLight light = _PointLights[vs_LightIndex];
+	gl_Position = _ViewProjection * vec4(light.position + vPos * light.radius * _VolumeScale, 1.0);
+}
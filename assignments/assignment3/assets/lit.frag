@@ -1,5 +1,7 @@
 #version 450
 
+#include "shadows.glsl"
+
 in vec4 LightSpacePos;
 in Surface {
 	vec3 WorldPos; // Vertex position in world space
@@ -31,7 +33,6 @@ struct Material {
 };
 uniform Material _Material;
 
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos);
 vec3 normal;
 vec3 toLight;
 
@@ -57,7 +58,8 @@ void main() {
 	vec3 lightColor = (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * _LightColor;
 	
 	// 1: in shadow, 0: out of shadow
-	float shadow = calcShadow(_ShadowMap, LightSpacePos);
+	float bias = max(_MaxBias * (1.0 - dot(normal, toLight)), _MinBias);
+	float shadow = calcShadow(_ShadowMap, LightSpacePos, bias);
 	lightColor *= (1.0 - shadow);
 
 	// Add some ambient light
@@ -66,25 +68,3 @@ void main() {
 	vec3 objectColor = texture(_MainTex, fs_in.TexCoord).rgb;
 	FragColor = vec4(objectColor * lightColor, 1.0);
 }
-
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos) {
-	// Homogeneous Clip space to NDC [-w, w] to [-1, 1]
-	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
-
-	// Convert from [-1, 1] to [0, 1]
-	sampleCoord = sampleCoord * 0.5 + 0.5;
-
-	float bias = max(_MaxBias * (1.0 - dot(normal, toLight)), _MinBias);
-	float myDepth = sampleCoord.z - bias;
-
-	// Percentage Closer Filtering
-	float totalShadow = 0;
-	vec2 texelOffset = 1.0 / textureSize(_ShadowMap, 0);
-	for (int y = -1; y <= 1; y++) {
-		for (int x = -1; x <= 1; x++) {
-			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
-			totalShadow += step(texture(_ShadowMap, uv).r, myDepth);
-		}
-	}
-	return totalShadow /= 9.0;
-}
\ No newline at end of file
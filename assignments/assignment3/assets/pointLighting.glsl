@@ -0,0 +1,42 @@
+// Blinn-phong point light shading shared by deferredLit.frag and lightVolume.frag
+
+uniform vec3 _EyePos;
+
+struct Material {
+	float Ka; // Ambient coefficient (0-1)
+	float Kd; // Diffuse coefficient (0-1)
+	float Ks; // Specular coefficient (0-1)
+	float Shininess; // Affects size of specular highlight
+};
+uniform Material _Material;
+
+float attenuateLinear(float d, float radius) {
+	return clamp((radius - d)/radius, 0.0, 1.0);
+}
+
+float attenuateExponential(float d, float radius) {
+	float i = clamp(1.0 - pow(d/radius, 4.0), 0.0, 1.0);
+	return i * i;
+}
+
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 pos) {
+	// Direction toward light position
+	vec3 diff = light.position - pos;
+	vec3 toLight = normalize(diff);
+
+	float diffuseFactor = 0.5 * max(dot(normal, toLight), 0.0);
+
+	// Direction towards eye
+	vec3 toEye = normalize(_EyePos - pos);
+
+	// Blinn-phong uses half angle
+	vec3 h = normalize(toLight + toEye);
+	float specularFactor = pow(max(dot(normal,h), 0.0), _Material.Shininess);
+
+	vec3 lightColor = (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * light.color.rgb;
+
+	float d = length(diff);
+	lightColor *= attenuateLinear(d, light.radius);
+
+	return lightColor;
+}
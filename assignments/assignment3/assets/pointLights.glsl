@@ -0,0 +1,10 @@
+struct PointLight {
+	vec3 position;
+	float radius;
+	vec4 color;
+};
+// Filled by nb::updateLightBuffer
+layout(std430, binding = 0) readonly buffer PointLightBuffer {
+	uint _NumPointLights;
+	PointLight _PointLights[];
+};
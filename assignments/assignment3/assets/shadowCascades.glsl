@@ -0,0 +1,20 @@
+// Cascade uniforms, set by nb::setShadowCascadeUniforms
+
+// Matches nb::MAX_SHADOW_CASCADES
+#define MAX_SHADOW_CASCADES 4
+
+uniform int _NumCascades;
+uniform mat4 _CascadeCameraView;
+uniform mat4 _CascadeViewProjections[MAX_SHADOW_CASCADES];
+uniform float _CascadeSplits[MAX_SHADOW_CASCADES]; // View depth where each cascade ends
+
+// Cascade whose slice of view depth holds worldPos, or -1 past the last one
+int getShadowCascade(vec3 worldPos) {
+	float depth = -(_CascadeCameraView * vec4(worldPos, 1.0)).z;
+	for (int i = 0; i < _NumCascades; i++) {
+		if (depth < _CascadeSplits[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
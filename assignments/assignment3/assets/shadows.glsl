@@ -0,0 +1,53 @@
+// Shared by lit.frag and deferredLit.frag through #include
+
+#include "shadowCascades.glsl"
+
+// Kernel is (2 * PCF_RADIUS + 1)^2 taps. Each variant of the lighting pass sets its own
+#ifndef PCF_RADIUS
+#define PCF_RADIUS 1
+#endif
+
+// 1: in shadow, 0: out of shadow
+float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float bias) {
+	// Homogeneous Clip space to NDC [-w, w] to [-1, 1]
+	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
+
+	// Convert from [-1, 1] to [0, 1]
+	sampleCoord = sampleCoord * 0.5 + 0.5;
+
+	float myDepth = sampleCoord.z - bias;
+
+	// Percentage Closer Filtering
+	float totalShadow = 0;
+	vec2 texelOffset = 1.0 / textureSize(shadowMap, 0);
+	for (int y = -PCF_RADIUS; y <= PCF_RADIUS; y++) {
+		for (int x = -PCF_RADIUS; x <= PCF_RADIUS; x++) {
+			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
+			totalShadow += step(texture(shadowMap, uv).r, myDepth);
+		}
+	}
+	return totalShadow / float((2 * PCF_RADIUS + 1) * (2 * PCF_RADIUS + 1));
+}
+
+// 1: in shadow, 0: out of shadow. Samples the layer of the cascade holding worldPos; past the last cascade is unshadowed
+float calcCascadedShadow(sampler2DArray shadowMap, vec3 worldPos, float bias) {
+	int cascade = getShadowCascade(worldPos);
+	if (cascade < 0) {
+		return 0.0;
+	}
+	vec4 lightSpacePos = _CascadeViewProjections[cascade] * vec4(worldPos, 1.0);
+	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+
+	float myDepth = sampleCoord.z - bias;
+
+	// Percentage Closer Filtering
+	float totalShadow = 0;
+	vec2 texelOffset = 1.0 / textureSize(shadowMap, 0).xy;
+	for (int y = -PCF_RADIUS; y <= PCF_RADIUS; y++) {
+		for (int x = -PCF_RADIUS; x <= PCF_RADIUS; x++) {
+			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
+			totalShadow += step(texture(shadowMap, vec3(uv, cascade)).r, myDepth);
+		}
+	}
+	return totalShadow / float((2 * PCF_RADIUS + 1) * (2 * PCF_RADIUS + 1));
+}
@@ -3,27 +3,41 @@
 
 #include <ew/external/glad.h>
 #include <ew/shader.h>
+#include <ew/shaderBatch.h>
+#include <ew/shaderPermutations.h>
+#include <ew/glState.h>
 #include <ew/model.h>
 #include <ew/camera.h>
 #include <ew/cameraController.h>
 #include <ew/transform.h>
 #include <ew/texture.h>
+#include <ew/resourceCache.h>
 #include <ew/procGen.h>
+#include <ew/meshOptimizer.h>
+#include <ew/meshlet.h>
+#include <ew/drawQueue.h>
+#include <ew/geometryArena.h>
+#include <ew/instanceBuffer.h>
 
-#include <nb/framebuffer.h>
 #include <nb/shadowmap.h>
+#include <nb/framebuffer.h>
 #include <nb/light.h>
+#include <nb/lightBuffer.h>
+#include <nb/lightClusters.h>
+#include <nb/renderGraph.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
-void drawUI();
+void drawUI(const nb::RenderGraph& renderGraph, const ew::DrawQueue& drawQueue, const unsigned int* gBufferTextures);
 
 // Global state
 int screenWidth = 1080;
@@ -37,33 +51,53 @@ const int numShaders = 5;
 int blurAmount = 2;
 
 // Framebuffers
-nb::Framebuffer framebuffer;
-nb::Framebuffer gBuffer;
-nb::ShadowMap shadowMap;
+nb::CascadedShadowMap shadowMap;
+nb::ShadowCache shadowCache;
+bool showGBuffers = true;
+bool compactGBuffer = true; // nb::GBufferLayout::Compact, else Wide
 
 // Camera
 ew::Camera camera;
 ew::CameraController cameraController;
-ew::Camera shadowCamera;
+ew::Camera shadowCamera; // Around every cascade; culls and picks LODs for the shadow pass
 
 // Shadow
-float shadowCamDistance = 10;
-float shadowCamOrthoHeight = 3;
+float shadowDistance = 40.0f; // View depth the cascades cover
+int numShadowCascades = 4;
+bool cacheStaticShadows = true;
 float minBias = 0.005, maxBias = 0.015;
+int pcfRadius = 1;
+const int MAX_PCF_RADIUS = 3;
+bool shadowsEnabled = true;
+
+// LOD
+float lodPixelError = 1.0f;
 
 // Lighting
-struct PointLight {
-	glm::vec3 position;
-	float radius = 15;
-	glm::vec4 color = { (double)rand() / RAND_MAX, (double)rand() / RAND_MAX, (double)rand() / RAND_MAX, 1.0f};
-};
 glm::vec3 lightDir{ -0.5, -1, -0.5 }, lightCol{ 1, 1, 1 };
 nb::Light mainLight = nb::createLight(lightDir, lightCol);
 float pointLightDist = 2.0f;
-const int MAX_POINT_LIGHTS = 64;
+const int MAX_POINT_LIGHTS = 1024;
+const int LIGHTS_PER_RING = 64;
 
-PointLight pointLights[MAX_POINT_LIGHTS];
+nb::PointLight pointLights[MAX_POINT_LIGHTS];
 int numPointLights = 64;
+float pointLightRadius = 4.0f;
+bool validateClusters = false;
+
+// How point lights are shaded
+enum LightingModes {
+	clusteredLighting, // In the full screen pass, from each pixel's cluster list
+	lightVolumeLighting, // Instanced spheres, depth tested against the gbuffer
+	stencilLightVolumeLighting, // One sphere per light, masked by a stencil pass first
+	numLightingModes
+};
+const char* lightingModeNames[numLightingModes] = { "Clustered", "Light Volumes", "Stencil Light Volumes" };
+int lightingMode = clusteredLighting;
+bool runLightingBenchmark = false;
+ew::InstanceData orbInstances[MAX_POINT_LIGHTS];
+bool runInstancingBenchmark = false;
+bool runImportBenchmark = false;
 
 struct Material {
 	float Ka = 1.0;
@@ -74,6 +108,11 @@ struct Material {
 
 
 
+// Draw queue passes, in submission order
+enum DrawPasses {
+	geometryDrawPass, shadowDrawPass, staticShadowDrawPass
+};
+
 enum PPShaders {
 	noPP, invertPP, boxBlurPP
 }curShader;
@@ -85,70 +124,111 @@ int main() {
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 	// OpenGL variables
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT); // Back face culling
-	glEnable(GL_DEPTH_TEST); // Depth testing
+	ew::setCullFace(true);
+	ew::setCullFaceMode(GL_FRONT); // Back face culling
+	ew::setDepthTest(true); // Depth testing
 
 	// Dummy VAO
 	unsigned int dummyVAO;
 	glCreateVertexArrays(1, &dummyVAO);
 
-	// Shaders
-	ew::Shader lit = ew::Shader("assets/lit.vert", "assets/lit.frag");
-	ew::Shader defLit = ew::Shader("assets/postprocessing.vert", "assets/deferredLit.frag");
-	ew::Shader gBufferShader = ew::Shader("assets/geometryPass.vert", "assets/geometryPass.frag");
-	ew::Shader depthOnly = ew::Shader("assets/depthOnly.vert", "assets/depthOnly.frag");
-	ew::Shader lightOrb = ew::Shader("assets/lightOrb.vert", "assets/lightOrb.frag");
-	ew::Shader noPP = ew::Shader("assets/postprocessing.vert", "assets/nopostprocessing.frag");
-	ew::Shader invert = ew::Shader("assets/postprocessing.vert", "assets/invert.frag");
-	ew::Shader boxblur = ew::Shader("assets/postprocessing.vert", "assets/boxblur.frag");
-
-	// Create vector of post processing shaders
-	shaders.reserve(numShaders);
-	shaders.push_back(noPP);
-	shaders.push_back(invert);
-	shaders.push_back(boxblur);
-	curShader = PPShaders::noPP;
-
-	// Framebuffers
-	framebuffer = nb::createFramebuffer(screenWidth, screenHeight, GL_RGB16F);
-	GLenum fboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (fboStatus != GL_FRAMEBUFFER_COMPLETE) {
-		printf("\nFramebuffer incomplete %d\n", fboStatus);
+	// Shaders, compiled in the background while the rest of the scene loads
+	ew::Shader lit, gBufferShader, gBufferCompactShader, shadowCascadeShader, lightOrb, lightOrbInstanced, lightVolumeShader, lightVolumeCompact, noPP, invert, boxblur;
+	ew::ShaderBatch shaderBatch;
+	shaderBatch.add(&lit, "assets/lit.vert", "assets/lit.frag");
+	shaderBatch.add(&gBufferShader, "assets/geometryPass.vert", "assets/geometryPass.frag");
+	shaderBatch.add(&gBufferCompactShader, "assets/geometryPass.vert", "assets/geometryPass.frag", { { "COMPACT_GBUFFER", 1 } });
+	shaderBatch.add(&lightOrb, "assets/lightOrb.vert", "assets/lightOrb.frag");
+	shaderBatch.add(&lightOrbInstanced, "assets/lightOrb.vert", "assets/lightOrb.frag", { { "INSTANCED" } });
+	shaderBatch.add(&lightVolumeShader, "assets/lightVolume.vert", "assets/lightVolume.frag");
+	shaderBatch.add(&lightVolumeCompact, "assets/lightVolume.vert", "assets/lightVolume.frag", { { "COMPACT_GBUFFER", 1 } });
+	// All cascades in one pass: the geometry shader sends each triangle to every cascade's layer
+	shaderBatch.addGeometry(&shadowCascadeShader, "assets/depthOnly.vert", "assets/shadowCascades.geom", "assets/depthOnly.frag", { { "CASCADED" } });
+	shaderBatch.add(&noPP, "assets/postprocessing.vert", "assets/nopostprocessing.frag");
+	shaderBatch.add(&invert, "assets/postprocessing.vert", "assets/invert.frag");
+	shaderBatch.add(&boxblur, "assets/postprocessing.vert", "assets/boxblur.frag");
+
+	// Lighting pass variants specialized on PCF kernel size, shadows, point lights and gbuffer layout.
+	// Every combination the UI can pick is built with the batch, so toggling never compiles mid frame
+	ew::ShaderPermutations deferredLitVariants("assets/postprocessing.vert", "assets/deferredLit.frag");
+	for (int radius = 0; radius <= MAX_PCF_RADIUS; radius++) {
+		for (int variant = 0; variant < 8; variant++) {
+			deferredLitVariants.prewarm(&shaderBatch, { { "PCF_RADIUS", radius }, { "SHADOWS", variant & 1 },
+				{ "POINT_LIGHTS", (variant >> 1) & 1 }, { "COMPACT_GBUFFER", (variant >> 2) & 1 } });
+		}
 	}
 
-	// Gbuffers
-	gBuffer = nb::createGBuffer(screenWidth, screenHeight);
-
-	// Shadowmap
-	shadowMap = nb::createShadowMap(screenWidth, screenHeight);
+	// Shadowmap cascades. Gbuffer and HDR targets are transients owned by the render graph
+	shadowMap = nb::createCascadedShadowMap(2048, numShadowCascades);
+	GLenum fboStatus = glCheckNamedFramebufferStatus(shadowMap.fbo, GL_FRAMEBUFFER);
 	if (fboStatus != GL_FRAMEBUFFER_COMPLETE) {
 		printf("\nShadowmap incomplete %d\n", fboStatus);
 	}
 
 	// Textures
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
-	GLuint defaultNormalTexture = ew::loadTexture("assets/Default_normal.jpg");
-	GLuint buildingTexture = ew::loadTexture("assets/Building_Color.png");
-	GLuint normalTexture = ew::loadTexture("assets/Building_NormalGL.png");
+	//Block compressed at build time by tools/texturecompressor
+	ew::TextureHandle brickTexture = ew::acquireTexture("assets/brick_color.dds");
+	ew::TextureHandle defaultNormalTexture = ew::acquireTexture("assets/Default_normal.dds", ew::TEXTURE_PLACEHOLDER_NORMAL);
+	ew::TextureHandle buildingTexture = ew::acquireTexture("assets/Building_Color.dds");
 
 	// Models & Meshes
-	ew::Model monkeyModel = ew::Model("assets/suzanne.fbx");
-	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(10, 10, 5));
-	ew::Mesh sphereMesh = ew::Mesh(ew::createSphere(1.0f, 8));
+	ew::ModelLoadOptions modelOptions;
+	modelOptions.optimize = true;
+	modelOptions.numLODs = 4;
+	modelOptions.buildMeshlets = true;
+	ew::ModelHandle monkeyHandle = ew::acquireModel("assets/suzanne.fbx", modelOptions);
+	ew::Model& monkeyModel = *monkeyHandle;
+
+	ew::MeshData planeData = ew::createPlane(10, 10, 5);
+	ew::MeshData sphereData = ew::createSphere(1.0f, 8);
+	ew::optimizeMesh(&planeData);
+	ew::optimizeMesh(&sphereData);
+	std::vector<ew::Meshlet> planeMeshlets;
+	ew::buildMeshlets(&planeData, &planeMeshlets);
+	ew::Mesh planeMesh = ew::Mesh(planeData);
+	planeMesh.setMeshlets(planeMeshlets.data(), planeMeshlets.size());
+	ew::Mesh sphereMesh = ew::Mesh(sphereData);
+	// Light volumes. The tessellated faces sit inside the unit sphere by up to cos(pi / subdivisions) per axis of rotation
+	const int LIGHT_VOLUME_SUBDIVISIONS = 16;
+	ew::Mesh lightVolumeMesh = ew::Mesh(ew::createSphere(1.0f, LIGHT_VOLUME_SUBDIVISIONS));
+	float lightVolumeInset = cos(3.14159265f / LIGHT_VOLUME_SUBDIVISIONS);
+	float lightVolumeScale = 1.0f / (lightVolumeInset * lightVolumeInset);
+
+	// Keep the window responsive while the driver finishes, then collect shader errors
+	while (!shaderBatch.isComplete() && !glfwWindowShouldClose(window)) {
+		glfwWaitEventsTimeout(0.01);
+	}
+	shaderBatch.finish();
+
+	// Create vector of post processing shaders
+	shaders.reserve(numShaders);
+	shaders.push_back(noPP);
+	shaders.push_back(invert);
+	shaders.push_back(boxblur);
+	curShader = PPShaders::noPP;
 
 	// Transforms
 	ew::Transform monkeyTransform;
 	ew::Transform planeTransform;
 	planeTransform.position = glm::vec3(0, -2, 0);
 
-	// Point lights
-	for (int i = 0; i < numPointLights; i++) {
-		float ang = 360.0f / numPointLights;
-		float theta = ang * i;
+	// Point lights, in rings of LIGHTS_PER_RING around the scene
+	for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+		float ang = 360.0f / LIGHTS_PER_RING;
+		float theta = ang * (i % LIGHTS_PER_RING);
+		float dist = pointLightDist * (1 + i / LIGHTS_PER_RING);
 
-		pointLights[i].position = { cos(theta) * pointLightDist, 1, sin(theta) * pointLightDist };
+		pointLights[i].position = { cos(theta) * dist, 1, sin(theta) * dist };
+		pointLights[i].color = { (double)rand() / RAND_MAX, (double)rand() / RAND_MAX, (double)rand() / RAND_MAX, 1.0f };
+		pointLights[i].radius = pointLightRadius;
 	}
+	// Storage buffer read by deferredLit.frag at binding 0
+	nb::LightBuffer pointLightBuffer = nb::createLightBuffer(MAX_POINT_LIGHTS, 0);
+	// Per cluster light lists, at bindings 3 and 4. Room for 128 lights per cluster on average
+	ew::Shader lightCulling = ew::Shader::compute("assets/lightCulling.comp");
+	nb::LightClusters lightClusters = nb::createLightClusters(16, 9, 24, 16 * 9 * 24 * 128);
+	// Orb transforms and colors, read by lightOrb.vert at binding 1
+	ew::InstanceBuffer orbInstanceBuffer(MAX_POINT_LIGHTS);
 
 	// Camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
@@ -156,142 +236,398 @@ int main() {
 	camera.fov = 60.0f; // Vertical field of view, in degrees
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 
-	// Shadow camera
-	shadowCamera.target = glm::vec3(0.0f, 0.0f, 0.0f); // Look at center of the scene
-	shadowCamera.position = shadowCamera.target - mainLight.direction * shadowCamDistance; // HAS TO BE A FLOAT OR WILL BREAK???
+	// Casters that never move are drawn into the cache only when it goes stale
+	shadowCache = nb::createShadowCache(shadowMap);
+
+	// Shadow camera, fitted to the cascades every frame
 	shadowCamera.orthographic = true;
-	shadowCamera.orthoHeight = shadowCamOrthoHeight;
 	shadowCamera.aspectRatio = 1;
+	shadowCamera.nearPlane = 0.0f;
+
+	nb::RenderGraph renderGraph;
+	ew::DrawQueue drawQueue;
+	nb::ClusterView clusterView;
+	// Recorded by the graph each frame
+	nb::RenderResource shadowTexture, gPosition, gNormal, gAlbedo, gDepth, gDepthCopy, hdrColor;
+
+	// Point lights as spheres blended over the lighting target, so each light only shades the pixels it can reach
+	auto drawLightVolumes = [&](bool stencil, int numLights) {
+		const ew::Shader& lightVolume = compactGBuffer ? lightVolumeCompact : lightVolumeShader;
+		lightVolume.use();
+		lightVolume.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+		lightVolume.setMat4("_InverseViewProjection", glm::inverse(camera.projectionMatrix() * camera.viewMatrix()));
+		lightVolume.setFloat("_VolumeScale", lightVolumeScale);
+		lightVolume.setVec3("_EyePos", camera.position);
+		lightVolume.setFloat("_Material.Ka", material.Ka);
+		lightVolume.setFloat("_Material.Kd", material.Kd);
+		lightVolume.setFloat("_Material.Ks", material.Ks);
+		lightVolume.setFloat("_Material.Shininess", material.Shininess);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		ew::setDepthWrite(false);
+		if (!stencil) {
+			// Back faces pass where the surface is in front of the far side of the sphere; the shader's falloff handles the rest
+			lightVolume.setInt("_FirstLight", 0);
+			ew::setDepthTest(true);
+			ew::setDepthFunc(GL_GEQUAL);
+			ew::setCullFaceMode(GL_FRONT);
+			lightVolumeMesh.drawInstanced(numLights);
+			ew::setDepthFunc(GL_LESS);
+		}
+		else {
+			// Stencil ends up non zero only where the surface lies between the front and back faces.
+			// Shading zeroes the pixels it touches, so the stencil is clear again for the next light
+			glEnable(GL_STENCIL_TEST);
+			glClear(GL_STENCIL_BUFFER_BIT);
+			ew::setDepthFunc(GL_LESS);
+			for (int i = 0; i < numLights; i++) {
+				lightVolume.setInt("_FirstLight", i);
+
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				ew::setDepthTest(true);
+				ew::setCullFace(false);
+				glStencilFunc(GL_ALWAYS, 0, 0xFF);
+				glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+				glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+				lightVolumeMesh.drawInstanced(1);
+
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				ew::setDepthTest(false);
+				ew::setCullFace(true);
+				ew::setCullFaceMode(GL_FRONT);
+				glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+				glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+				lightVolumeMesh.drawInstanced(1);
+			}
+			glDisable(GL_STENCIL_TEST);
+		}
+		glDisable(GL_BLEND);
+		ew::setDepthWrite(true);
+		ew::setDepthTest(true);
+		ew::setCullFaceMode(GL_BACK);
+	};
+
+	// Directional light over the whole screen, with point lights either in the same shader or drawn as volumes after it
+	auto drawLighting = [&](const nb::RenderGraph& graph, int mode, int numLights) {
+		ew::setCullFaceMode(GL_BACK); // Back face culling
+
+		// Binding textures
+		ew::bindTextureUnit(0, graph.getTexture(gPosition));
+		ew::bindTextureUnit(1, graph.getTexture(gNormal));
+		ew::bindTextureUnit(2, graph.getTexture(gAlbedo));
+		ew::bindTextureUnit(3, graph.getTexture(shadowTexture));
+
+		const ew::Shader& defLit = deferredLitVariants.get({ { "PCF_RADIUS", pcfRadius }, { "SHADOWS", shadowsEnabled ? 1 : 0 },
+			{ "POINT_LIGHTS", mode == clusteredLighting ? 1 : 0 }, { "COMPACT_GBUFFER", compactGBuffer ? 1 : 0 } });
+		defLit.use();
+		nb::bindLightBuffer(pointLightBuffer);
+		nb::bindLightClusters(lightClusters);
+		nb::setLightClusterUniforms(defLit, lightClusters, clusterView);
+		defLit.setVec3("_MainLight.dir", mainLight.direction);
+		defLit.setVec3("_MainLight.color", mainLight.color);
+		nb::setShadowCascadeUniforms(defLit, shadowMap);
+		defLit.setFloat("_MinBias", minBias);
+		defLit.setFloat("_MaxBias", maxBias);
+
+		defLit.setInt("_gPositions", 0);
+		defLit.setMat4("_InverseViewProjection", glm::inverse(camera.projectionMatrix() * camera.viewMatrix()));
+		defLit.setInt("_gNormals", 1);
+		defLit.setInt("_gAlbedo", 2);
+		defLit.setInt("_ShadowMap", 3);
+
+		defLit.setVec3("_EyePos", camera.position);
+		defLit.setFloat("_Material.Ka", material.Ka);
+		defLit.setFloat("_Material.Kd", material.Kd);
+		defLit.setFloat("_Material.Ks", material.Ks);
+		defLit.setFloat("_Material.Shininess", material.Shininess);
+
+		// Light volumes need the gbuffer depth attached, which the full screen triangles must leave alone
+		ew::setDepthTest(false);
+		ew::bindVertexArray(dummyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		ew::setDepthTest(true);
+
+		if (mode != clusteredLighting) {
+			drawLightVolumes(mode == stencilLightVolumeLighting, numLights);
+		}
+	};
+
+	// Prints GPU time of every lighting mode over a few light counts and radii, culling included for the clustered mode
+	auto benchmarkLighting = [&](const nb::RenderGraph& graph) {
+		const int counts[] = { 64, 256, 1024 };
+		const float radii[] = { 1.0f, 4.0f, 8.0f };
+		const int iterations = 10;
+		unsigned int queries[2];
+		glGenQueries(2, queries);
+		printf("Lighting benchmark: average GPU ms of %d frames\n", iterations);
+		for (float radius : radii) {
+			for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+				pointLights[i].radius = radius;
+			}
+			for (int count : counts) {
+				nb::updateLightBuffer(&pointLightBuffer, pointLights, count);
+				printf("  %4d lights, radius %4.1f:", count, radius);
+				for (int mode = 0; mode < numLightingModes; mode++) {
+					glFinish();
+					glQueryCounter(queries[0], GL_TIMESTAMP);
+					for (int i = 0; i < iterations; i++) {
+						if (mode == clusteredLighting) {
+							nb::cullLightClusters(lightClusters, lightCulling, pointLightBuffer, clusterView);
+						}
+						drawLighting(graph, mode, count);
+					}
+					glQueryCounter(queries[1], GL_TIMESTAMP);
+					GLuint64 start = 0, end = 0;
+					glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+					glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+					printf(" | %s %7.3fms", lightingModeNames[mode], (end - start) / 1000000.0 / iterations);
+				}
+				printf("\n");
+			}
+		}
+		glDeleteQueries(2, queries);
+
+		// Back to this frame's lights
+		for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+			pointLights[i].radius = pointLightRadius;
+		}
+		nb::updateLightBuffer(&pointLightBuffer, pointLights, numPointLights);
+		nb::cullLightClusters(lightClusters, lightCulling, pointLightBuffer, clusterView);
+	};
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		ew::updateTextureLoads();
+		ew::beginGLStateFrame();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
 		prevFrameTime = time;
 
-		// === GEOMETRY PASS ===
+		// Camera movement
+		cameraController.move(window, &camera, deltaTime);
+
+		// Rotate model around Y axis
+		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
+
+		// Shadow cascades follow the camera. The shadow camera looks down the light over all of them, casters included
+		shadowMap.numCascades = numShadowCascades;
+		nb::updateShadowCascades(&shadowMap, camera, mainLight.direction, shadowDistance);
+		shadowCamera.target = shadowMap.boundsCenter;
+		shadowCamera.position = shadowMap.boundsCenter - glm::normalize(mainLight.direction) * (shadowMap.boundsRadius + shadowMap.casterMargin);
+		shadowCamera.orthoHeight = shadowMap.boundsRadius * 2.0f;
+		shadowCamera.farPlane = shadowMap.boundsRadius * 2.0f + shadowMap.casterMargin;
+		// The plane is the only static caster
+		if (!cacheStaticShadows) {
+			nb::invalidateShadowCache(&shadowCache);
+		}
+		glm::mat4 staticCasterTransforms[] = { planeTransform.modelMatrix() };
+		bool drawStaticShadows = nb::updateShadowCache(&shadowCache, shadowMap, staticCasterTransforms, 1);
+
+		// Scene draws, sorted by state once and replayed by the geometry and shadow passes
+		drawQueue.clear();
+		drawQueue.setView(geometryDrawPass, camera);
+		// Front faces are culled in the shadow pass, so skip meshlets that face the light instead of away from it
+		drawQueue.setView(shadowDrawPass, shadowCamera, true);
+		drawQueue.setView(staticShadowDrawPass, shadowCamera, true);
 		{
-			// Bind to Gbuffer
-			glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
-			glViewport(0, 0, gBuffer.width, gBuffer.height);
+			ew::DrawPacket packet;
+			packet.cullMeshlets = true;
+
+			packet.pass = geometryDrawPass;
+			packet.shader = compactGBuffer ? &gBufferCompactShader : &gBufferShader;
+			packet.modelMatrix = monkeyTransform.modelMatrix();
+			packet.textures[0] = buildingTexture->texture;
+			packet.textures[1] = defaultNormalTexture->texture;
+			drawQueue.submit(monkeyModel, monkeyModel.selectLOD(camera, packet.modelMatrix, (float)screenHeight, lodPixelError), packet);
+
+			packet.mesh = &planeMesh;
+			packet.modelMatrix = planeTransform.modelMatrix();
+			packet.textures[0] = brickTexture->texture;
+			packet.textures[1] = defaultNormalTexture->texture;
+			drawQueue.submit(packet);
+
+			packet = ew::DrawPacket();
+			packet.cullMeshlets = true;
+			packet.pass = shadowDrawPass;
+			packet.shader = &shadowCascadeShader;
+			packet.modelMatrix = monkeyTransform.modelMatrix();
+			drawQueue.submit(monkeyModel, monkeyModel.selectLOD(shadowCamera, packet.modelMatrix, (float)shadowMap.resolution, lodPixelError), packet);
+
+			packet.pass = staticShadowDrawPass;
+			packet.mesh = &planeMesh;
+			packet.modelMatrix = planeTransform.modelMatrix();
+			drawQueue.submit(packet);
+		}
+		drawQueue.sort();
+
+		// Screen sized targets are transient; the graph pools them and recreates them after a resize
+		nb::RenderTextureDesc screenDesc;
+		screenDesc.width = screenWidth;
+		screenDesc.height = screenHeight;
+		screenDesc.wrap = GL_CLAMP_TO_BORDER; // Clamp to border so we don't wrap when sampling for post processing
+
+		nb::RenderResource backbuffer = renderGraph.importBackbuffer(screenWidth, screenHeight);
+		nb::RenderTextureDesc shadowDesc;
+		shadowDesc.width = shadowMap.resolution;
+		shadowDesc.height = shadowMap.resolution;
+		shadowDesc.format = GL_DEPTH_COMPONENT32F;
+		// An array texture, so the graph's framebuffer for it is layered
+		shadowTexture = renderGraph.importTexture("Shadow Map", shadowMap.depthTexture, shadowDesc);
+		nb::RenderResource staticShadowTexture = renderGraph.importTexture("Static Shadows", shadowCache.staticDepthTexture, shadowDesc);
+
+		// === GEOMETRY PASS ===
+		renderGraph.addPass("Geometry", [&](nb::RenderPassBuilder& builder) {
+			nb::GBufferFormats formats = nb::getGBufferFormats(compactGBuffer ? nb::GBufferLayout::Compact : nb::GBufferLayout::Wide);
+			nb::RenderTextureDesc desc = screenDesc;
+			if (formats.position != 0) {
+				desc.format = formats.position;
+				gPosition = builder.create("gPosition", desc);
+			}
+			desc.format = formats.normal;
+			gNormal = builder.create("gNormal", desc);
+			desc.format = formats.albedo;
+			gAlbedo = builder.create("gAlbedo", desc);
+			desc.format = formats.depth;
+			gDepth = builder.create("gDepth", desc);
+			// Position is rebuilt from depth, so depth takes its place for the passes that read the gbuffer
+			if (formats.position == 0) {
+				gPosition = gDepth;
+			}
+		}, [&](const nb::RenderGraph& graph) {
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glCullFace(GL_BACK); // Front face culling
-
-			glBindTextureUnit(0, defaultNormalTexture);
-			glBindTextureUnit(1, brickTexture);
-			glBindTextureUnit(2, buildingTexture);
-			glBindTextureUnit(3, normalTexture);
-
-			gBufferShader.use();
-			gBufferShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-
-			gBufferShader.setInt("_MainTex", 2);
-			gBufferShader.setInt("_NormalTex", 3);
-			gBufferShader.setMat4("_Model", monkeyTransform.modelMatrix());
-			monkeyModel.draw();
-
-			gBufferShader.setInt("_MainTex", 1);
-			gBufferShader.setInt("_NormalTex", 0);
-			gBufferShader.setMat4("_Model", planeTransform.modelMatrix());
-			planeMesh.draw();
-
+			ew::setCullFaceMode(GL_BACK); // Front face culling
+
+			// Packets bind their albedo to unit 0 and normal map to unit 1
+			const ew::Shader& gBuffer = compactGBuffer ? gBufferCompactShader : gBufferShader;
+			gBuffer.use();
+			gBuffer.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			gBuffer.setInt("_MainTex", 0);
+			gBuffer.setInt("_NormalTex", 1);
+			drawQueue.draw(geometryDrawPass);
+		});
+
+		// === STATIC SHADOW PASS ===
+		// Only added on frames where the cache went stale
+		if (drawStaticShadows) {
+			renderGraph.addPass("Static Shadows", [&](nb::RenderPassBuilder& builder) {
+				builder.write(staticShadowTexture);
+			}, [&](const nb::RenderGraph& graph) {
+				glClear(GL_DEPTH_BUFFER_BIT);
+				ew::setCullFaceMode(GL_FRONT); // Front face culling
+
+				shadowCascadeShader.use();
+				nb::setShadowCascadeUniforms(shadowCascadeShader, shadowMap);
+				drawQueue.draw(staticShadowDrawPass);
+			});
 		}
 
 		// === SHADOWMAP PASS ===
-		{
-			// Bind to shadow framebuffer
-			glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.sfbo);
-			glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glCullFace(GL_FRONT); // Front face culling
-
-			depthOnly.use();
-			depthOnly.setMat4("_ViewProjection", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-
-			depthOnly.setMat4("_Model", monkeyTransform.modelMatrix());
-			monkeyModel.draw();
-
-			depthOnly.setMat4("_Model", planeTransform.modelMatrix());
-			planeMesh.draw();
+		// Starts from the static casters and adds the dynamic ones
+		renderGraph.addPass("Shadow Map", [&](nb::RenderPassBuilder& builder) {
+			builder.read(staticShadowTexture);
+			builder.write(shadowTexture);
+		}, [&](const nb::RenderGraph& graph) {
+			nb::copyStaticShadows(shadowCache, shadowMap);
+			ew::setCullFaceMode(GL_FRONT); // Front face culling
+
+			shadowCascadeShader.use();
+			nb::setShadowCascadeUniforms(shadowCascadeShader, shadowMap);
+			drawQueue.draw(shadowDrawPass);
+		});
+
+		// === LIGHT CULLING PASS ===
+		clusterView.view = camera.viewMatrix();
+		clusterView.projection = camera.projectionMatrix();
+		clusterView.nearPlane = 0.1f; // Slices closer than this would be too thin to hold anything
+		clusterView.farPlane = camera.farPlane;
+		renderGraph.addPass("Light Culling", [&](nb::RenderPassBuilder& builder) {
+			builder.setSideEffect();
+		}, [&](const nb::RenderGraph& graph) {
+			// Upload every point light at once
+			nb::updateLightBuffer(&pointLightBuffer, pointLights, numPointLights);
+			if (lightingMode == clusteredLighting || validateClusters) {
+				nb::cullLightClusters(lightClusters, lightCulling, pointLightBuffer, clusterView);
+			}
+			if (validateClusters) {
+				nb::validateLightClusters(lightClusters, clusterView, pointLights, numPointLights);
+				validateClusters = false;
+			}
+		});
+
+		// === DEPTH COPY PASS ===
+		// Stencil light volumes write the stencil of gDepth while it is attached. The compact layout rebuilds position
+		// from that same texture, so in that case lighting samples a copy rather than forming a feedback loop
+		if (compactGBuffer && (lightingMode == stencilLightVolumeLighting || runLightingBenchmark)) {
+			renderGraph.addPass("Depth Copy", [&](nb::RenderPassBuilder& builder) {
+				builder.read(gDepth);
+				nb::RenderTextureDesc desc = screenDesc;
+				desc.format = nb::getGBufferFormats(nb::GBufferLayout::Compact).depth;
+				gDepthCopy = builder.create("gDepth Copy", desc);
+				gPosition = gDepthCopy;
+			}, [&](const nb::RenderGraph& graph) {
+				glCopyImageSubData(graph.getTexture(gDepth), GL_TEXTURE_2D, 0, 0, 0, 0,
+					graph.getTexture(gDepthCopy), GL_TEXTURE_2D, 0, 0, 0, 0, screenWidth, screenHeight, 1);
+			});
 		}
 
 		// === LIGHTING PASS ===
-		{
-			// Bind to framebuffer
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+		renderGraph.addPass("Lighting", [&](nb::RenderPassBuilder& builder) {
+			builder.read(gPosition);
+			builder.read(gNormal);
+			builder.read(gAlbedo);
+			builder.read(shadowTexture);
+			nb::RenderTextureDesc desc = screenDesc;
+			desc.format = GL_RGB16F;
+			hdrColor = builder.create("HDR Color", desc);
+			// Light volumes depth test against the gbuffer depth with depth writes off. Plain volumes write nothing to it,
+			// so the compact layout can keep sampling it for position; stencil volumes read the copy made above
+			if (lightingMode != clusteredLighting || runLightingBenchmark) {
+				builder.read(gDepth);
+				builder.write(gDepth);
+			}
+		}, [&](const nb::RenderGraph& graph) {
 			glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glCullFace(GL_BACK); // Back face culling
-
-			// Binding textures
-			glBindTextureUnit(0, gBuffer.colorBuffers[0]);
-			glBindTextureUnit(1, gBuffer.colorBuffers[1]);
-			glBindTextureUnit(2, gBuffer.colorBuffers[2]);
-			glBindTextureUnit(3, shadowMap.depthTexture);
-
-			// Camera movement
-			cameraController.move(window, &camera, deltaTime);
-
-			// Rotate model around Y axis
-			monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
-
-			defLit.use();
-			// Set each point light as uniform
-			for (int i = 0; i < numPointLights; i++) {
-				std::string prefix = "_PointLights[" + std::to_string(i) + "].";
-				defLit.setVec3(prefix + "position", pointLights[i].position);
-				defLit.setFloat(prefix + "radius", pointLights[i].radius);
-				defLit.setVec4(prefix + "color", pointLights[i].color);
+			glClear(GL_COLOR_BUFFER_BIT);
+			// Runs inside this pass's GL_TIME_ELAPSED query, which cannot nest, so the benchmark times with timestamps
+			if (runLightingBenchmark) {
+				benchmarkLighting(graph);
+				runLightingBenchmark = false;
 			}
-			defLit.setVec3("_MainLight.dir", mainLight.direction);
-			defLit.setVec3("_MainLight.color", mainLight.color);
-			defLit.setMat4("_LightViewProjection", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-			defLit.setFloat("_MinBias", minBias);
-			defLit.setFloat("_MaxBias", maxBias);
-
-			defLit.setInt("_gPositions", 0);
-			defLit.setInt("_gNormals", 1);
-			defLit.setInt("_gAlbedo", 2);
-			defLit.setInt("_ShadowMap", 3);
-
-			defLit.setVec3("_EyePos", camera.position);
-			defLit.setFloat("_Material.Ka", material.Ka);
-			defLit.setFloat("_Material.Kd", material.Kd);
-			defLit.setFloat("_Material.Ks", material.Ks);
-			defLit.setFloat("_Material.Shininess", material.Shininess);
-
-			glBindVertexArray(dummyVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-		}
+			drawLighting(graph, lightingMode, numPointLights);
+		});
 
 		// === LIGHT ORB PASS ===
-		{
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer.fbo);
-			glBlitFramebuffer(0, 0, screenWidth, screenHeight,
-				0, 0, screenWidth, screenHeight,
-				GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-
-			lightOrb.use();
-			lightOrb.setMat4("_ViewProjection", camera.projectionMatrix()* camera.viewMatrix());
+		// Depth tests straight against the gbuffer depth instead of blitting it into another target
+		renderGraph.addPass("Light Orbs", [&](nb::RenderPassBuilder& builder) {
+			builder.read(gDepth);
+			builder.write(hdrColor);
+			builder.write(gDepth);
+		}, [&](const nb::RenderGraph& graph) {
+			// Every orb in one draw
 			for (int i = 0; i < numPointLights; i++) {
 				glm::mat4 orb = glm::mat4(1.0f);
 				orb = glm::translate(orb, pointLights[i].position);
 				orb = glm::scale(orb, glm::vec3(0.2f));
 
-				lightOrb.setMat4("_Model", orb);
-				lightOrb.setVec3("_Color", pointLights[i].color);
-				sphereMesh.draw();
+				orbInstances[i].model = orb;
+				orbInstances[i].color = pointLights[i].color;
 			}
-		}
+			orbInstanceBuffer.update(orbInstances, numPointLights);
+			orbInstanceBuffer.bind(1);
+
+			lightOrbInstanced.use();
+			lightOrbInstanced.setMat4("_ViewProjection", camera.projectionMatrix()* camera.viewMatrix());
+			sphereMesh.drawInstanced(numPointLights);
+		});
 
 		// === POST-PROCESSING PASS ===
-		{
-			glBindTextureUnit(0, framebuffer.fbo);
-			// Bind back to front buffer (0)
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		renderGraph.addPass("Post Processing", [&](nb::RenderPassBuilder& builder) {
+			builder.read(hdrColor);
+			builder.write(backbuffer);
+		}, [&](const nb::RenderGraph& graph) {
+			ew::bindTextureUnit(0, graph.getTexture(hdrColor));
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			// Set post-processing shader
@@ -310,14 +646,40 @@ int main() {
 				boxblur.setInt("_BlurAmount", blurAmount);
 				break;
 			}
-		}
-
-		glBindVertexArray(dummyVAO);
 
-		// Draw fullscreen quad
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+			ew::bindVertexArray(dummyVAO);
 
-		drawUI();
+			// Draw fullscreen quad
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		});
+
+		// === UI PASS ===
+		// Reading the gbuffers keeps them alive until the debug view has drawn them
+		renderGraph.addPass("UI", [&](nb::RenderPassBuilder& builder) {
+			builder.setSideEffect();
+			builder.read(shadowTexture);
+			if (showGBuffers) {
+				builder.read(gPosition);
+				builder.read(gNormal);
+				builder.read(gAlbedo);
+			}
+			builder.write(backbuffer);
+		}, [&](const nb::RenderGraph& graph) {
+			unsigned int gBufferTextures[3] = { graph.getTexture(gPosition), graph.getTexture(gNormal), graph.getTexture(gAlbedo) };
+			drawUI(renderGraph, drawQueue, gBufferTextures);
+		});
+
+		renderGraph.execute();
+
+		// Outside the graph, so its timer queries never overlap a pass's own
+		if (runInstancingBenchmark) {
+			ew::benchmarkInstancedDraw(sphereMesh, lightOrb, lightOrbInstanced, 1, camera.projectionMatrix() * camera.viewMatrix());
+			runInstancingBenchmark = false;
+		}
+		if (runImportBenchmark) {
+			ew::benchmarkModelImport("assets/suzanne.fbx", std::max(std::thread::hardware_concurrency(), 1u));
+			runImportBenchmark = false;
+		}
 
 		glfwSwapBuffers(window);
 	}
@@ -330,7 +692,7 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0.0;
 }
 
-void drawUI() {
+void drawUI(const nb::RenderGraph& renderGraph, const ew::DrawQueue& drawQueue, const unsigned int* gBufferTextures) {
 	ImGui_ImplGlfw_NewFrame();
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui::NewFrame();
@@ -356,21 +718,91 @@ void drawUI() {
 		}
 		if (ImGui::DragFloat3("Direction", &lightDir[0],0.05)) {
 			mainLight.changeDirection(lightDir);
-			shadowCamera.position = shadowCamera.target - mainLight.direction * shadowCamDistance;
 		}
-		ImGui::SliderInt("Num Point Lights", &numPointLights, 4.0, 64.0);
-	}
-
-	// Shadowmap camera GUI
-	if (ImGui::CollapsingHeader("Shadowmap Camera")) {
-		if (ImGui::SliderFloat("Distance", &shadowCamDistance, 0.0f, 50.f)) {
-			shadowCamera.position = shadowCamera.target - mainLight.direction * shadowCamDistance;
+		ImGui::SliderInt("Num Point Lights", &numPointLights, 4, MAX_POINT_LIGHTS);
+		if (ImGui::SliderFloat("Point Light Radius", &pointLightRadius, 0.5f, 15.0f)) {
+			for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+				pointLights[i].radius = pointLightRadius;
+			}
+		}
+		ImGui::Combo("Point Light Path", &lightingMode, lightingModeNames, numLightingModes);
+		// Times each path over several light counts and radii; results are printed to the console
+		if (ImGui::Button("Benchmark Lighting")) {
+			runLightingBenchmark = true;
+		}
+		// Compares the GPU cluster lists against the CPU reference; results are printed to the console
+		if (ImGui::Button("Validate Light Clusters")) {
+			validateClusters = true;
 		}
-		if (ImGui::SliderFloat("Ortho Height", &shadowCamOrthoHeight, 0.0f, 50.0f)) {
-			shadowCamera.orthoHeight = shadowCamOrthoHeight;
+		// Results are printed to the console
+		if (ImGui::Button("Benchmark Instanced Orbs")) {
+			runInstancingBenchmark = true;
 		}
+	}
+
+	// Shadow cascades GUI
+	if (ImGui::CollapsingHeader("Shadow Cascades")) {
+		ImGui::SliderInt("Cascades", &numShadowCascades, 1, nb::MAX_SHADOW_CASCADES);
+		ImGui::SliderFloat("Shadow Distance", &shadowDistance, 1.0f, 100.0f);
+		// 0 spaces cascades evenly, 1 logarithmically
+		ImGui::SliderFloat("Split Lambda", &shadowMap.splitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Caster Margin", &shadowMap.casterMargin, 0.0f, 50.0f);
+		// Static casters are redrawn only when the cascades or their transforms change
+		ImGui::Checkbox("Cache Static Shadows", &cacheStaticShadows);
+		ImGui::Text("Static shadow redraws: %u, reuses: %u", shadowCache.numStaticRenders, shadowCache.numReuses);
 		ImGui::SliderFloat("Min Bias", &minBias, 0.0f, 0.05f);
 		ImGui::SliderFloat("Max Bias", &maxBias, 0.0f, 0.5f);
+		ImGui::Checkbox("Shadows", &shadowsEnabled);
+		ImGui::SliderInt("PCF Radius", &pcfRadius, 0, MAX_PCF_RADIUS);
+	}
+
+	// LOD GUI
+	if (ImGui::CollapsingHeader("LOD")) {
+		ImGui::SliderFloat("Max Pixel Error", &lodPixelError, 0.0f, 16.0f);
+		// Mesh conversion time for 1 up to every hardware thread; results are printed to the console
+		if (ImGui::Button("Benchmark Model Import")) {
+			runImportBenchmark = true;
+		}
+	}
+
+	// GL state tracker GUI
+	if (ImGui::CollapsingHeader("GL State")) {
+		ew::GLStateStats glStateStats = ew::getGLStateStats();
+		ImGui::Text("State changes: %u", glStateStats.calls);
+		ImGui::Text("Redundant (skipped): %u", glStateStats.skipped);
+	}
+
+	// Draw queue GUI
+	if (ImGui::CollapsingHeader("Draw Queue")) {
+		const ew::DrawQueueStats& drawStats = drawQueue.getStats();
+		ImGui::Text("Packets: %u", drawStats.numPackets);
+		ImGui::Text("Indirect commands: %u", drawStats.numCommands);
+		ImGui::Text("Multi draw calls: %u", drawStats.numMultiDraws);
+		ImGui::Text("Program changes: %u", drawStats.programChanges);
+		ImGui::Text("Texture set changes: %u", drawStats.textureChanges);
+		const char* vertexFormatNames[ew::NUM_VERTEX_FORMATS] = { "Full", "Packed", "Quantized" };
+		for (unsigned int format = 0; format < ew::NUM_VERTEX_FORMATS; format++) {
+			const ew::GeometryArena* arena = ew::findGeometryArena((ew::VertexFormat)format);
+			if (arena == nullptr) {
+				continue;
+			}
+			ew::GeometryArenaStats arenaStats = arena->getStats();
+			ImGui::Text("%s arena: %u meshes, %u/%u vertices", vertexFormatNames[format], arenaStats.numAllocations, arenaStats.verticesUsed, arenaStats.vertexCapacity);
+			ImGui::Text("%s arena indices: %.1f/%.1f KB", vertexFormatNames[format], arenaStats.indexBytesUsed / 1024.0f, arenaStats.indexCapacity / 1024.0f);
+		}
+	}
+
+	// Render graph GUI
+	if (ImGui::CollapsingHeader("Render Graph")) {
+		for (const nb::RenderPassTiming& timing : renderGraph.getPassTimings()) {
+			ImGui::Text("%s: %.3f ms", timing.name.c_str(), timing.gpuMs);
+		}
+		ImGui::Text("Culled passes: %u", renderGraph.getNumCulledPasses());
+		ImGui::Text("Transient targets: %.1f MB", renderGraph.getTransientBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Allocated targets: %.1f MB", renderGraph.getAllocatedBytes() / (1024.0f * 1024.0f));
+		ImGui::Checkbox("Show GBuffers", &showGBuffers);
+		// Octahedral normals, RGBA8 albedo and position from depth
+		ImGui::Checkbox("Compact GBuffer", &compactGBuffer);
 	}
 
 	// Shaders list GUI
@@ -394,19 +826,28 @@ void drawUI() {
 	ImGui::Begin("Shadow Map");
 	ImGui::BeginChild("Shadow Map");
 
+	// One view per cascade layer, side by side
 	ImVec2 windowSize = ImGui::GetWindowSize();
-	ImGui::Image((ImTextureID)shadowMap.depthTexture, windowSize, ImVec2(0, 1), ImVec2(1, 0));
+	ImVec2 cascadeSize = ImVec2(windowSize.x / shadowMap.numCascades, windowSize.x / shadowMap.numCascades);
+	for (unsigned int i = 0; i < shadowMap.numCascades; i++) {
+		if (i > 0) {
+			ImGui::SameLine(0.0f, 0.0f);
+		}
+		ImGui::Image((ImTextureID)shadowMap.layerViews[i], cascadeSize, ImVec2(0, 1), ImVec2(1, 0));
+	}
 
 	ImGui::EndChild();
 	ImGui::End();
 
 	// GBuffers debug render
-	ImGui::Begin("GBuffers");
-	ImVec2 texSize = ImVec2(gBuffer.width / 4, gBuffer.height / 4);
-	for (size_t i = 0; i < 3; i++) {
-		ImGui::Image((ImTextureID)gBuffer.colorBuffers[i], texSize, ImVec2(0, 1), ImVec2(1, 0));
+	if (showGBuffers) {
+		ImGui::Begin("GBuffers");
+		ImVec2 texSize = ImVec2(screenWidth / 4, screenHeight / 4);
+		for (size_t i = 0; i < 3; i++) {
+			ImGui::Image((ImTextureID)gBufferTextures[i], texSize, ImVec2(0, 1), ImVec2(1, 0));
+		}
+		ImGui::End();
 	}
-	ImGui::End();
 
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
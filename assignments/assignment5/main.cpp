@@ -83,8 +83,8 @@ int main() {
 	}
 
 	// Textures
-	GLuint buildingTexture = ew::loadTexture("assets/Building_Color.png");
-	GLuint normalTexture = ew::loadTexture("assets/Building_NormalGL.png");
+	GLuint buildingTexture = ew::loadTextureAsync("assets/Building_Color.png");
+	GLuint normalTexture = ew::loadTextureAsync("assets/Building_NormalGL.png", ew::TEXTURE_PLACEHOLDER_NORMAL);
 
 	// Models
 	ew::Model monkeyModel = ew::Model("assets/suzanne.fbx");
@@ -135,6 +135,7 @@ int main() {
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		ew::updateTextureLoads();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
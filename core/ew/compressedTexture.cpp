@@ -0,0 +1,327 @@
+#include "compressedTexture.h"
+#include "external/glad.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+//S3TC is an extension (EXT_texture_compression_s3tc, EXT_texture_sRGB) rather than core GL, so glad does not define it
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace ew {
+	static const uint32_t DDS_MAGIC = 0x20534444; //"DDS "
+	static const uint32_t DDS_HEADER_SIZE = 124;
+	static const uint32_t DDS_DX10_HEADER_SIZE = 20;
+	static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	static const size_t KTX2_HEADER_SIZE = 80;
+
+	static uint32_t makeFourCC(char a, char b, char c, char d) {
+		return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+	}
+
+	static uint32_t readU32(const unsigned char* bytes) {
+		return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	}
+
+	static uint64_t readU64(const unsigned char* bytes) {
+		return (uint64_t)readU32(bytes) | ((uint64_t)readU32(bytes + 4) << 32);
+	}
+
+	static bool hasExtension(const std::string& path, const char* extension) {
+		size_t length = strlen(extension);
+		if (path.size() < length) {
+			return false;
+		}
+		for (size_t i = 0; i < length; i++)
+		{
+			char c = path[path.size() - length + i];
+			if (c >= 'A' && c <= 'Z') {
+				c = c - 'A' + 'a';
+			}
+			if (c != extension[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static unsigned int getGLFormat(BlockCompression format, bool srgb) {
+		switch (format) {
+		default:
+		case BlockCompression::BC1:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case BlockCompression::BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockCompression::BC5:
+			return GL_COMPRESSED_RG_RGTC2;
+		case BlockCompression::BC7:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	size_t getBlockSize(BlockCompression format) {
+		return format == BlockCompression::BC1 ? 8 : 16;
+	}
+
+	size_t getCompressedLevelSize(BlockCompression format, unsigned int width, unsigned int height) {
+		size_t blocksX = (width + 3) / 4;
+		size_t blocksY = (height + 3) / 4;
+		return (blocksX > 0 ? blocksX : 1) * (blocksY > 0 ? blocksY : 1) * getBlockSize(format);
+	}
+
+	/// <summary>
+	/// Lays out numLevels mips from width x height, each halving until 1x1.
+	/// Returns the total byte size, or 0 if more levels were asked for than the chain has.
+	/// </summary>
+	static size_t buildLevelLayout(CompressedTextureData* texture, unsigned int width, unsigned int height, unsigned int numLevels) {
+		texture->levels.clear();
+		size_t offset = 0;
+		for (unsigned int i = 0; i < numLevels; i++)
+		{
+			CompressedMipLevel level;
+			level.width = width;
+			level.height = height;
+			level.offset = offset;
+			level.size = getCompressedLevelSize(texture->format, width, height);
+			texture->levels.push_back(level);
+			offset += level.size;
+			if (width == 1 && height == 1 && i + 1 < numLevels) {
+				return 0;
+			}
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		return offset;
+	}
+
+	static bool parseDDS(const std::vector<unsigned char>& file, CompressedTextureData* texture) {
+		if (file.size() < 4 + DDS_HEADER_SIZE || readU32(&file[4]) != DDS_HEADER_SIZE) {
+			return false;
+		}
+		const unsigned char* header = &file[4];
+		unsigned int height = readU32(header + 8);
+		unsigned int width = readU32(header + 12);
+		unsigned int numLevels = readU32(header + 24);
+		uint32_t fourCC = readU32(header + 80);
+		size_t dataOffset = 4 + DDS_HEADER_SIZE;
+		texture->srgb = false;
+		if (fourCC == makeFourCC('D', 'X', '1', '0')) {
+			if (file.size() < dataOffset + DDS_DX10_HEADER_SIZE) {
+				return false;
+			}
+			uint32_t dxgiFormat = readU32(&file[dataOffset]);
+			uint32_t arraySize = readU32(&file[dataOffset + 12]);
+			dataOffset += DDS_DX10_HEADER_SIZE;
+			if (arraySize > 1) {
+				printf("DDS texture arrays are not supported\n");
+				return false;
+			}
+			switch (dxgiFormat) {
+			case 71: texture->format = BlockCompression::BC1; break;
+			case 72: texture->format = BlockCompression::BC1; texture->srgb = true; break;
+			case 77: texture->format = BlockCompression::BC3; break;
+			case 78: texture->format = BlockCompression::BC3; texture->srgb = true; break;
+			case 83: texture->format = BlockCompression::BC5; break;
+			case 98: texture->format = BlockCompression::BC7; break;
+			case 99: texture->format = BlockCompression::BC7; texture->srgb = true; break;
+			default:
+				printf("Unsupported DXGI format %u\n", dxgiFormat);
+				return false;
+			}
+		}
+		else if (fourCC == makeFourCC('D', 'X', 'T', '1')) {
+			texture->format = BlockCompression::BC1;
+		}
+		else if (fourCC == makeFourCC('D', 'X', 'T', '5')) {
+			texture->format = BlockCompression::BC3;
+		}
+		else if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U')) {
+			texture->format = BlockCompression::BC5;
+		}
+		else {
+			printf("Unsupported DDS pixel format\n");
+			return false;
+		}
+		size_t dataSize = buildLevelLayout(texture, width, height, numLevels > 0 ? numLevels : 1);
+		if (width == 0 || height == 0 || dataSize == 0 || file.size() < dataOffset + dataSize) {
+			return false;
+		}
+		texture->bytes.assign(file.begin() + dataOffset, file.begin() + dataOffset + dataSize);
+		return true;
+	}
+
+	static bool parseKTX2(const std::vector<unsigned char>& file, CompressedTextureData* texture) {
+		if (file.size() < KTX2_HEADER_SIZE) {
+			return false;
+		}
+		uint32_t vkFormat = readU32(&file[12]);
+		unsigned int width = readU32(&file[20]);
+		unsigned int height = readU32(&file[24]);
+		uint32_t depth = readU32(&file[28]);
+		uint32_t numLayers = readU32(&file[32]);
+		uint32_t numFaces = readU32(&file[36]);
+		unsigned int numLevels = readU32(&file[40]);
+		uint32_t supercompression = readU32(&file[44]);
+		if (depth > 1 || numLayers > 1 || numFaces != 1 || supercompression != 0) {
+			printf("Only plain 2D KTX2 textures without supercompression are supported\n");
+			return false;
+		}
+		texture->srgb = false;
+		switch (vkFormat) {
+		case 131: case 133: texture->format = BlockCompression::BC1; break;
+		case 132: case 134: texture->format = BlockCompression::BC1; texture->srgb = true; break;
+		case 137: texture->format = BlockCompression::BC3; break;
+		case 138: texture->format = BlockCompression::BC3; texture->srgb = true; break;
+		case 141: texture->format = BlockCompression::BC5; break;
+		case 145: texture->format = BlockCompression::BC7; break;
+		case 146: texture->format = BlockCompression::BC7; texture->srgb = true; break;
+		default:
+			printf("Unsupported KTX2 vkFormat %u\n", vkFormat);
+			return false;
+		}
+		//A level count of 0 asks the loader to generate mips, which block compressed data cannot do
+		numLevels = numLevels > 0 ? numLevels : 1;
+		if (file.size() < KTX2_HEADER_SIZE + numLevels * 24) {
+			return false;
+		}
+		size_t dataSize = buildLevelLayout(texture, width, height, numLevels);
+		if (width == 0 || height == 0 || dataSize == 0) {
+			return false;
+		}
+		//Levels are stored smallest first in the file but indexed largest first
+		texture->bytes.resize(dataSize);
+		for (unsigned int i = 0; i < numLevels; i++)
+		{
+			const unsigned char* entry = &file[KTX2_HEADER_SIZE + i * 24];
+			uint64_t offset = readU64(entry);
+			uint64_t length = readU64(entry + 8);
+			const CompressedMipLevel& level = texture->levels[i];
+			if (length != level.size || offset > file.size() || file.size() - offset < length) {
+				return false;
+			}
+			memcpy(&texture->bytes[level.offset], &file[(size_t)offset], level.size);
+		}
+		return true;
+	}
+
+	bool isCompressedTextureFile(const char* filePath) {
+		return hasExtension(filePath, ".dds") || hasExtension(filePath, ".ktx2");
+	}
+
+	/// <summary>
+	/// Reads a DDS or KTX2 file holding a single 2D BC1, BC3, BC5 or BC7 image and its mips
+	/// </summary>
+	bool readCompressedTexture(const char* filePath, CompressedTextureData* texture) {
+		FILE* f = fopen(filePath, "rb");
+		if (f == NULL) {
+			printf("Failed to load image %s\n", filePath);
+			return false;
+		}
+		std::vector<unsigned char> file;
+		unsigned char buffer[65536];
+		size_t numRead;
+		while ((numRead = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+			file.insert(file.end(), buffer, buffer + numRead);
+		}
+		fclose(f);
+
+		bool success = false;
+		if (file.size() >= sizeof(KTX2_IDENTIFIER) && memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+			success = parseKTX2(file, texture);
+		}
+		else if (file.size() >= 4 && readU32(file.data()) == DDS_MAGIC) {
+			success = parseDDS(file, texture);
+		}
+		if (!success) {
+			printf("Failed to read compressed texture %s\n", filePath);
+		}
+		return success;
+	}
+
+	/// <summary>
+	/// Writes a DDS file with a DX10 header, so sRGB and BC7 round trip
+	/// </summary>
+	bool writeDDS(const char* filePath, const CompressedTextureData& texture) {
+		if (texture.levels.empty()) {
+			return false;
+		}
+		uint32_t header[1 + DDS_HEADER_SIZE / 4 + DDS_DX10_HEADER_SIZE / 4] = {};
+		uint32_t* dds = &header[1];
+		uint32_t* dx10 = &header[1 + DDS_HEADER_SIZE / 4];
+		header[0] = DDS_MAGIC;
+		dds[0] = DDS_HEADER_SIZE;
+		dds[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; //Caps, height, width, pixel format, mip count, linear size
+		dds[2] = texture.levels[0].height;
+		dds[3] = texture.levels[0].width;
+		dds[4] = (uint32_t)texture.levels[0].size;
+		dds[6] = (uint32_t)texture.levels.size();
+		dds[18] = 32; //Pixel format size
+		dds[19] = 0x4; //Pixel format has a FourCC
+		dds[20] = makeFourCC('D', 'X', '1', '0');
+		dds[26] = 0x1000 | (texture.levels.size() > 1 ? 0x400000 | 0x8 : 0); //Texture, mipmap, complex
+		static const uint32_t DXGI_FORMATS[4][2] = { { 71, 72 }, { 77, 78 }, { 83, 83 }, { 98, 99 } };
+		dx10[0] = DXGI_FORMATS[(int)texture.format][texture.srgb ? 1 : 0];
+		dx10[1] = 3; //Texture2D
+		dx10[3] = 1; //Array size
+
+		FILE* file = fopen(filePath, "wb");
+		if (file == NULL) {
+			printf("Failed to write %s\n", filePath);
+			return false;
+		}
+		bool success = fwrite(header, sizeof(header), 1, file) == 1;
+		success = success && fwrite(texture.bytes.data(), 1, texture.bytes.size(), file) == texture.bytes.size();
+		fclose(file);
+		if (!success) {
+			printf("Failed to write %s\n", filePath);
+		}
+		return success;
+	}
+
+	unsigned int loadCompressedTexture(const char* filePath) {
+		return loadCompressedTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
+	}
+
+	/// <summary>
+	/// Uploads a DDS/KTX2 file's blocks and stored mip chain as is. Mips are never generated at runtime.
+	/// </summary>
+	unsigned int loadCompressedTexture(const char* filePath, int wrapMode, int magFilter, int minFilter) {
+		CompressedTextureData data;
+		if (!readCompressedTexture(filePath, &data)) {
+			return 0;
+		}
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		unsigned int format = getGLFormat(data.format, data.srgb);
+		for (size_t i = 0; i < data.levels.size(); i++)
+		{
+			const CompressedMipLevel& level = data.levels[i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (int)i, format, level.width, level.height, 0, (int)level.size, &data.bytes[level.offset]);
+		}
+		//Clamp to the stored chain so files without a full chain are still mipmap complete
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)data.levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+
+		//Black border by default
+		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+}
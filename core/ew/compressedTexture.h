@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+namespace ew {
+	//Block compressed formats ew can load. Every format stores 4x4 texel blocks.
+	enum class BlockCompression {
+		BC1 = 0, //RGB, 8 bytes per block
+		BC3 = 1, //RGBA, 16 bytes per block
+		BC5 = 2, //RG (two channel normal maps, z is reconstructed in the shader), 16 bytes per block
+		BC7 = 3 //RGBA high quality, 16 bytes per block. Loaded only; ew does not encode it
+	};
+	size_t getBlockSize(BlockCompression format);
+	size_t getCompressedLevelSize(BlockCompression format, unsigned int width, unsigned int height);
+
+	struct CompressedMipLevel {
+		unsigned int width = 0;
+		unsigned int height = 0;
+		size_t offset = 0; //Into CompressedTextureData::bytes
+		size_t size = 0;
+	};
+
+	//A block compressed image with its mip chain, largest level first
+	struct CompressedTextureData {
+		BlockCompression format = BlockCompression::BC1;
+		bool srgb = false;
+		std::vector<CompressedMipLevel> levels;
+		std::vector<unsigned char> bytes;
+	};
+
+	bool isCompressedTextureFile(const char* filePath);
+	bool readCompressedTexture(const char* filePath, CompressedTextureData* texture);
+	bool writeDDS(const char* filePath, const CompressedTextureData& texture);
+	unsigned int loadCompressedTexture(const char* filePath);
+	unsigned int loadCompressedTexture(const char* filePath, int wrapMode, int magFilter, int minFilter);
+}
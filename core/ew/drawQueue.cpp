@@ -0,0 +1,304 @@
+#include "drawQueue.h"
+#include "meshlet.h"
+#include "glState.h"
+#include "geometryArena.h"
+#include "external/glad.h"
+#include <algorithm>
+
+namespace ew {
+	static const unsigned int PASS_SHIFT = 60;
+	static const unsigned int TRANSPARENT_SHIFT = 59;
+	static const unsigned int PROGRAM_SHIFT = 45;
+	static const unsigned int TEXTURE_SET_SHIFT = 31;
+	static const unsigned int GEOMETRY_SHIFT = 24;
+	static const uint32_t PROGRAM_MASK = (1u << 14) - 1;
+	static const uint32_t TEXTURE_SET_MASK = (1u << 14) - 1;
+	static const uint32_t DEPTH_MASK = (1u << 24) - 1;
+
+	/// <summary>
+	/// LSD radix sort of keys, carrying values along, 8 bits per pass.
+	/// Bytes that are equal in every key are skipped, which is most of them when only a few passes and programs are in use.
+	/// </summary>
+	void radixSortKeys(std::vector<uint64_t>* keys, std::vector<uint32_t>* values, std::vector<uint64_t>* scratchKeys, std::vector<uint32_t>* scratchValues) {
+		const size_t count = keys->size();
+		scratchKeys->resize(count);
+		scratchValues->resize(count);
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			size_t offsets[256] = {};
+			for (size_t i = 0; i < count; i++)
+			{
+				offsets[((*keys)[i] >> shift) & 0xFF]++;
+			}
+			if (count == 0 || offsets[((*keys)[0] >> shift) & 0xFF] == count) {
+				continue;
+			}
+			size_t sum = 0;
+			for (int b = 0; b < 256; b++)
+			{
+				size_t bucket = offsets[b];
+				offsets[b] = sum;
+				sum += bucket;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				size_t dst = offsets[((*keys)[i] >> shift) & 0xFF]++;
+				(*scratchKeys)[dst] = (*keys)[i];
+				(*scratchValues)[dst] = (*values)[i];
+			}
+			keys->swap(*scratchKeys);
+			values->swap(*scratchValues);
+		}
+	}
+
+	DrawQueue::~DrawQueue() {
+		release();
+	}
+
+	/// <summary>
+	/// Forgets packets, views and id tables. Call once per frame before submitting.
+	/// </summary>
+	void DrawQueue::clear() {
+		m_packets.clear();
+		m_keys.clear();
+		m_order.clear();
+		m_sorted = false;
+		m_prepared = false;
+		for (unsigned int i = 0; i < DRAW_QUEUE_MAX_PASSES; i++)
+		{
+			m_views[i].valid = false;
+		}
+		m_programIds.clear();
+		m_textureSetIds.clear();
+		m_commands.clear();
+		m_batches.clear();
+		m_objects.clear();
+		m_stats = DrawQueueStats();
+	}
+
+	/// <summary>
+	/// Camera a pass is drawn from. Used for depth sorting and for packets with cullMeshlets. Set before submitting to the pass.
+	/// </summary>
+	void DrawQueue::setView(unsigned int pass, const Camera& camera, bool cullFrontFaces) {
+		if (pass >= DRAW_QUEUE_MAX_PASSES) {
+			return;
+		}
+		PassView& view = m_views[pass];
+		view.camera = camera;
+		view.forward = glm::normalize(camera.target - camera.position);
+		view.cullFrontFaces = cullFrontFaces;
+		view.valid = true;
+	}
+
+	uint64_t DrawQueue::makeKey(const DrawPacket& packet) {
+		uint32_t programId = m_programIds.emplace(packet.shader->getId(), (uint32_t)m_programIds.size()).first->second;
+		TextureSet textureSet;
+		std::copy(packet.textures, packet.textures + DRAW_PACKET_MAX_TEXTURES, textureSet.begin());
+		uint32_t textureSetId = m_textureSetIds.emplace(textureSet, (uint32_t)m_textureSetIds.size()).first->second;
+		uint32_t geometry = (uint32_t)packet.mesh->getVertexFormat() * 2 + (packet.mesh->getIndexType() == IndexType::UINT32 ? 1 : 0);
+
+		//Distance along the view direction, 0 at the near plane and 1 at the far plane
+		uint32_t depth = 0;
+		const PassView& view = m_views[packet.pass];
+		if (view.valid) {
+			glm::vec3 position = glm::vec3(packet.modelMatrix[3]);
+			float distance = glm::dot(position - view.camera.position, view.forward);
+			float t = glm::clamp((distance - view.camera.nearPlane) / (view.camera.farPlane - view.camera.nearPlane), 0.0f, 1.0f);
+			depth = (uint32_t)(t * DEPTH_MASK);
+		}
+		if (packet.transparent) {
+			depth = DEPTH_MASK - depth;
+		}
+
+		//Ids past their field width share the last value; grouping gets coarser but order stays valid
+		return ((uint64_t)packet.pass << PASS_SHIFT)
+			| ((uint64_t)(packet.transparent ? 1 : 0) << TRANSPARENT_SHIFT)
+			| ((uint64_t)std::min(programId, PROGRAM_MASK) << PROGRAM_SHIFT)
+			| ((uint64_t)std::min(textureSetId, TEXTURE_SET_MASK) << TEXTURE_SET_SHIFT)
+			| ((uint64_t)geometry << GEOMETRY_SHIFT)
+			| depth;
+	}
+
+	void DrawQueue::submit(const DrawPacket& packet) {
+		if (packet.mesh == nullptr || packet.shader == nullptr || packet.pass >= DRAW_QUEUE_MAX_PASSES || packet.mesh->getNumIndices() == 0) {
+			return;
+		}
+		m_keys.push_back(makeKey(packet));
+		m_order.push_back((uint32_t)m_packets.size());
+		m_packets.push_back(packet);
+		m_sorted = false;
+		m_prepared = false;
+	}
+
+	/// <summary>
+	/// Submits every mesh of one detail level with the same state
+	/// </summary>
+	void DrawQueue::submit(const Model& model, unsigned int lod, const DrawPacket& packet) {
+		if (model.getNumLODs() == 0) {
+			return;
+		}
+		const ModelLOD& level = model.getLOD(glm::min(lod, model.getNumLODs() - 1));
+		DrawPacket meshPacket = packet;
+		for (size_t i = level.firstMesh; i < level.firstMesh + level.numMeshes; i++)
+		{
+			meshPacket.mesh = &model.getMesh(i);
+			submit(meshPacket);
+		}
+	}
+
+	void DrawQueue::sort() {
+		if (!m_sorted) {
+			radixSortKeys(&m_keys, &m_order, &m_scratchKeys, &m_scratchOrder);
+			m_sorted = true;
+		}
+	}
+
+	/// <summary>
+	/// One command for the whole mesh, or one per run of visible meshlets when culling
+	/// </summary>
+	void DrawQueue::addCommands(const DrawPacket& packet, uint32_t objectIndex) {
+		const Mesh& mesh = *packet.mesh;
+		IndirectCommand command;
+		command.instanceCount = 1;
+		command.baseVertex = (int32_t)mesh.getBaseVertex();
+		command.baseInstance = objectIndex;
+		const PassView& view = m_views[packet.pass];
+		if (!packet.cullMeshlets || !view.valid || mesh.getMeshlets().empty()) {
+			command.count = mesh.getNumIndices();
+			command.firstIndex = mesh.getFirstIndex();
+			m_commands.push_back(command);
+			return;
+		}
+		MeshletCullView cullView = ew::createMeshletCullView(view.camera, packet.modelMatrix, view.cullFrontFaces);
+		bool merging = false;
+		unsigned int rangeEnd = 0;
+		for (const Meshlet& meshlet : mesh.getMeshlets())
+		{
+			if (!ew::isMeshletVisible(meshlet, cullView)) {
+				merging = false;
+				continue;
+			}
+			//Neighbors in the index buffer merge into one command
+			if (merging && rangeEnd == meshlet.firstIndex) {
+				m_commands.back().count += meshlet.numTriangles * 3;
+			}
+			else {
+				command.count = meshlet.numTriangles * 3;
+				command.firstIndex = mesh.getFirstIndex() + meshlet.firstIndex;
+				m_commands.push_back(command);
+			}
+			merging = true;
+			rangeEnd = meshlet.firstIndex + meshlet.numTriangles * 3;
+		}
+	}
+
+	/// <summary>
+	/// Builds every pass's commands and batches in key order and uploads them with the object data, once per frame
+	/// </summary>
+	void DrawQueue::prepare() {
+		sort();
+		m_commands.clear();
+		m_batches.clear();
+		m_objects.resize(m_packets.size());
+		//Object indices run up to the packet count, so every arena drawn from needs that many ids
+		bool formatUsed[NUM_VERTEX_FORMATS] = {};
+		for (const DrawPacket& packet : m_packets)
+		{
+			formatUsed[(int)packet.mesh->getVertexFormat()] = true;
+		}
+		for (unsigned int format = 0; format < NUM_VERTEX_FORMATS; format++)
+		{
+			if (formatUsed[format]) {
+				getGeometryArena((VertexFormat)format).reserveObjectIds((unsigned int)m_packets.size());
+			}
+		}
+		for (size_t i = 0; i < m_order.size(); i++)
+		{
+			uint32_t objectIndex = m_order[i];
+			const DrawPacket& packet = m_packets[objectIndex];
+			m_objects[objectIndex].model = packet.modelMatrix;
+			m_objects[objectIndex].color = packet.color;
+
+			//Everything above the depth bits is state one call cannot change
+			const uint64_t stateMask = ~(uint64_t)DEPTH_MASK;
+			size_t firstCommand = m_commands.size();
+			if (m_batches.empty() || (m_keys[i] & stateMask) != (m_keys[i - 1] & stateMask)
+				|| m_batches.back().shader->getId() != packet.shader->getId()
+				|| !std::equal(packet.textures, packet.textures + DRAW_PACKET_MAX_TEXTURES, m_batches.back().textures)) {
+				Batch batch;
+				batch.pass = packet.pass;
+				batch.shader = packet.shader;
+				batch.textures = packet.textures;
+				batch.vao = packet.mesh->getVAO();
+				batch.indexType = packet.mesh->getIndexType();
+				batch.firstCommand = firstCommand;
+				batch.numCommands = 0;
+				m_batches.push_back(batch);
+			}
+			addCommands(packet, objectIndex);
+			m_batches.back().numCommands += m_commands.size() - firstCommand;
+		}
+
+		m_objectBuffer.update(m_objects.data(), (unsigned int)m_objects.size());
+		if (m_commandBuffer == 0) {
+			glCreateBuffers(1, &m_commandBuffer);
+		}
+		//Orphaned each frame like the object buffer
+		glNamedBufferData(m_commandBuffer, m_commands.size() * sizeof(IndirectCommand), m_commands.data(), GL_STREAM_DRAW);
+		m_stats.numPackets = (unsigned int)m_packets.size();
+		m_stats.numCommands = (unsigned int)m_commands.size();
+		m_prepared = true;
+	}
+
+	/// <summary>
+	/// Draws one pass with one glMultiDrawElementsIndirect call per run of equal program, textures and geometry.
+	/// Prepares the frame's commands on the first call after submitting. Returns the number of calls made.
+	/// </summary>
+	unsigned int DrawQueue::draw(unsigned int pass) {
+		if (!m_prepared) {
+			prepare();
+		}
+		if (m_commands.empty()) {
+			return 0;
+		}
+		m_objectBuffer.bind(DRAW_QUEUE_OBJECT_BINDING);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+
+		const Shader* shader = nullptr;
+		const unsigned int* textures = nullptr;
+		unsigned int numCalls = 0;
+		for (const Batch& batch : m_batches)
+		{
+			if (batch.pass != pass || batch.numCommands == 0) {
+				continue;
+			}
+			if (shader == nullptr || shader->getId() != batch.shader->getId()) {
+				shader = batch.shader;
+				shader->use();
+				m_stats.programChanges++;
+			}
+			if (textures == nullptr || !std::equal(batch.textures, batch.textures + DRAW_PACKET_MAX_TEXTURES, textures)) {
+				for (unsigned int unit = 0; unit < DRAW_PACKET_MAX_TEXTURES; unit++)
+				{
+					if (batch.textures[unit] != 0) {
+						ew::bindTextureUnit(unit, batch.textures[unit]);
+					}
+				}
+				textures = batch.textures;
+				m_stats.textureChanges++;
+			}
+			ew::bindVertexArray(batch.vao);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType == IndexType::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+				(const void*)(batch.firstCommand * sizeof(IndirectCommand)), (GLsizei)batch.numCommands, 0);
+			numCalls++;
+		}
+		m_stats.numMultiDraws += numCalls;
+		return numCalls;
+	}
+
+	void DrawQueue::release() {
+		m_objectBuffer.release();
+		glDeleteBuffers(1, &m_commandBuffer);
+		m_commandBuffer = 0;
+	}
+}
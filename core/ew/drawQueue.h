@@ -0,0 +1,114 @@
+#pragma once
+#include "mesh.h"
+#include "model.h"
+#include "shader.h"
+#include "camera.h"
+#include "instanceBuffer.h"
+#include <array>
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ew {
+	const unsigned int DRAW_PACKET_MAX_TEXTURES = 4;
+	const unsigned int DRAW_QUEUE_MAX_PASSES = 16;
+	//Storage buffer binding of the per-object InstanceData. Shaders index it with the arena's object attribute:
+	//  layout(location = 4) in uint vObjectIndex;
+	//  layout(std430, binding = 2) readonly buffer ObjectBuffer { InstanceData _Objects[]; };
+	const unsigned int DRAW_QUEUE_OBJECT_BINDING = 2;
+
+	//One draw. Mesh and shader must outlive the frame they are submitted in.
+	struct DrawPacket {
+		const Mesh* mesh = nullptr;
+		const Shader* shader = nullptr;
+		unsigned int textures[DRAW_PACKET_MAX_TEXTURES] = {}; //Bound to units 0-3 in order. 0 leaves the unit alone
+		glm::mat4 modelMatrix = glm::mat4(1.0f); //_Objects[vObjectIndex].model
+		glm::vec4 color = glm::vec4(1.0f); //_Objects[vObjectIndex].color
+		unsigned int pass = 0; //Below DRAW_QUEUE_MAX_PASSES. Drawn with DrawQueue::draw(pass)
+		bool transparent = false; //Sorted after opaque packets, back to front
+		bool cullMeshlets = false; //Cull meshlets against the pass's view, see DrawQueue::setView
+	};
+
+	struct DrawQueueStats {
+		unsigned int numPackets = 0;
+		unsigned int numCommands = 0; //Indirect commands; meshlet culled packets emit one per visible range
+		unsigned int numMultiDraws = 0; //glMultiDrawElementsIndirect calls
+		unsigned int programChanges = 0;
+		unsigned int textureChanges = 0;
+	};
+
+	/// <summary>
+	/// Collects a frame's draws and submits them grouped by state. Each packet gets a 64 bit key, most significant first:
+	/// pass (4) | transparent (1) | program (14) | texture set (14) | geometry (7) | depth (24).
+	/// Program and texture set are dense ids handed out as they are first seen this frame, so equal state sorts together.
+	/// Geometry is the packet's arena and index type, the state one indirect call cannot change.
+	/// Opaque packets draw front to back within equal state (early depth rejection), transparent ones back to front.
+	/// Every run of equal state is one glMultiDrawElementsIndirect call; object transforms come from a storage buffer.
+	/// </summary>
+	class DrawQueue {
+	public:
+		DrawQueue() {};
+		~DrawQueue();
+		void clear();
+		void setView(unsigned int pass, const Camera& camera, bool cullFrontFaces = false);
+		void submit(const DrawPacket& packet);
+		void submit(const Model& model, unsigned int lod, const DrawPacket& packet);
+		void sort();
+		unsigned int draw(unsigned int pass);
+		void release();
+		inline size_t getNumPackets()const { return m_packets.size(); }
+		inline const DrawQueueStats& getStats()const { return m_stats; } //Summed over every draw() since clear()
+	private:
+		DrawQueue(const DrawQueue&) = delete;
+		DrawQueue& operator=(const DrawQueue&) = delete;
+		struct PassView {
+			Camera camera;
+			glm::vec3 forward = glm::vec3(0.0f, 0.0f, -1.0f);
+			bool cullFrontFaces = false;
+			bool valid = false;
+		};
+		//Matches GL's DrawElementsIndirectCommand
+		struct IndirectCommand {
+			uint32_t count;
+			uint32_t instanceCount;
+			uint32_t firstIndex;
+			int32_t baseVertex;
+			uint32_t baseInstance; //Object index
+		};
+		//A run of commands drawn with one call
+		struct Batch {
+			unsigned int pass;
+			const Shader* shader;
+			const unsigned int* textures;
+			unsigned int vao;
+			IndexType indexType;
+			size_t firstCommand;
+			size_t numCommands;
+		};
+		typedef std::array<unsigned int, DRAW_PACKET_MAX_TEXTURES> TextureSet;
+
+		uint64_t makeKey(const DrawPacket& packet);
+		void addCommands(const DrawPacket& packet, uint32_t objectIndex);
+		void prepare();
+
+		std::vector<DrawPacket> m_packets;
+		std::vector<uint64_t> m_keys;
+		std::vector<uint32_t> m_order; //Packet indices in key order after sort()
+		std::vector<uint64_t> m_scratchKeys;
+		std::vector<uint32_t> m_scratchOrder;
+		bool m_sorted = false;
+		bool m_prepared = false;
+		PassView m_views[DRAW_QUEUE_MAX_PASSES];
+		std::unordered_map<unsigned int, uint32_t> m_programIds; //GL program -> dense id
+		std::map<TextureSet, uint32_t> m_textureSetIds;
+		std::vector<IndirectCommand> m_commands;
+		std::vector<Batch> m_batches;
+		std::vector<InstanceData> m_objects; //Indexed by packet
+		InstanceBuffer m_objectBuffer;
+		unsigned int m_commandBuffer = 0;
+		DrawQueueStats m_stats;
+	};
+
+	void radixSortKeys(std::vector<uint64_t>* keys, std::vector<uint32_t>* values, std::vector<uint64_t>* scratchKeys, std::vector<uint32_t>* scratchValues);
+}
@@ -0,0 +1,268 @@
+#include "geometryArena.h"
+#include "vertexPacking.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <iterator>
+#include <stdint.h>
+#include <vector>
+
+namespace ew {
+	void RangeAllocator::addRange(size_t offset, size_t size) {
+		free(offset, size);
+	}
+
+	/// <summary>
+	/// Takes size units from the first free range that fits once its start is aligned. Alignment must be a power of two.
+	/// </summary>
+	bool RangeAllocator::allocate(size_t size, size_t alignment, size_t* offset) {
+		for (auto it = m_free.begin(); it != m_free.end(); ++it)
+		{
+			size_t start = (it->first + alignment - 1) & ~(alignment - 1);
+			size_t end = it->first + it->second;
+			if (start + size > end) {
+				continue;
+			}
+			size_t rangeStart = it->first;
+			m_free.erase(it);
+			//Keep whatever is left on either side
+			if (start > rangeStart) {
+				m_free[rangeStart] = start - rangeStart;
+			}
+			if (start + size < end) {
+				m_free[start + size] = end - (start + size);
+			}
+			*offset = start;
+			return true;
+		}
+		return false;
+	}
+
+	void RangeAllocator::free(size_t offset, size_t size) {
+		if (size == 0) {
+			return;
+		}
+		auto next = m_free.lower_bound(offset);
+		//Merge with the range ending where this one starts
+		if (next != m_free.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				offset = prev->first;
+				size += prev->second;
+				m_free.erase(prev);
+			}
+		}
+		//And with the one starting where it ends
+		if (next != m_free.end() && offset + size == next->first) {
+			size += next->second;
+			m_free.erase(next);
+		}
+		m_free[offset] = size;
+	}
+
+	/// <summary>
+	/// DSA version of the attribute layouts Mesh used to set per VAO. Shaders see the same vec3/vec2 inputs for every format.
+	/// </summary>
+	static void setupArenaAttributes(unsigned int vao, VertexFormat format) {
+		switch (format) {
+		case VertexFormat::FULL:
+			glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+			glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+			glVertexArrayAttribFormat(vao, 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, tangent));
+			glVertexArrayAttribFormat(vao, 3, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv));
+			break;
+		case VertexFormat::PACKED:
+			glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, pos));
+			glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal));
+			glVertexArrayAttribFormat(vao, 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, tangent));
+			glVertexArrayAttribFormat(vao, 3, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, uv));
+			break;
+		case VertexFormat::PACKED_QUANTIZED:
+			//Positions come out in [0,1] and are mapped back to the mesh bounds by Mesh::getDequantizationMatrix
+			glVertexArrayAttribFormat(vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(QuantizedVertex, pos));
+			glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(QuantizedVertex, normal));
+			glVertexArrayAttribFormat(vao, 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(QuantizedVertex, tangent));
+			glVertexArrayAttribFormat(vao, 3, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(QuantizedVertex, uv));
+			break;
+		}
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glVertexArrayAttribBinding(vao, i, 0);
+			glEnableVertexArrayAttrib(vao, i);
+		}
+		glVertexArrayAttribIFormat(vao, GEOMETRY_ARENA_OBJECT_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0);
+		glVertexArrayAttribBinding(vao, GEOMETRY_ARENA_OBJECT_ATTRIBUTE, 1);
+		glVertexArrayBindingDivisor(vao, 1, 1);
+		glEnableVertexArrayAttrib(vao, GEOMETRY_ARENA_OBJECT_ATTRIBUTE);
+	}
+
+	/// <summary>
+	/// New immutable buffer of newSize bytes holding the first oldSize bytes of buffer, which is deleted
+	/// </summary>
+	static unsigned int resizeBuffer(unsigned int buffer, size_t oldSize, size_t newSize) {
+		unsigned int newBuffer;
+		glCreateBuffers(1, &newBuffer);
+		glNamedBufferStorage(newBuffer, newSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		if (buffer != 0) {
+			if (oldSize > 0) {
+				glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, oldSize);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+		return newBuffer;
+	}
+
+	GeometryArena::GeometryArena(VertexFormat format, unsigned int vertexCapacity, size_t indexCapacity)
+		: m_format(format), m_vertexSize(getVertexSize(format))
+	{
+		glCreateVertexArrays(1, &m_vao);
+		setupArenaAttributes(m_vao, format);
+		growVertices(vertexCapacity);
+		growIndices(indexCapacity);
+		reserveObjectIds(1024);
+	}
+
+	void GeometryArena::growVertices(unsigned int numVertices) {
+		unsigned int capacity = m_vertexCapacity > 0 ? m_vertexCapacity * 2 : numVertices;
+		while (capacity < m_vertexCapacity + numVertices) {
+			capacity *= 2;
+		}
+		m_vertexBuffer = resizeBuffer(m_vertexBuffer, m_vertexCapacity * m_vertexSize, capacity * m_vertexSize);
+		m_vertexRanges.addRange(m_vertexCapacity, capacity - m_vertexCapacity);
+		m_vertexCapacity = capacity;
+		glVertexArrayVertexBuffer(m_vao, 0, m_vertexBuffer, 0, (GLsizei)m_vertexSize);
+	}
+
+	void GeometryArena::growIndices(size_t indexSize) {
+		size_t capacity = m_indexCapacity > 0 ? m_indexCapacity * 2 : indexSize;
+		//Slack for aligning a range that coalesced with an unaligned free tail
+		while (capacity < m_indexCapacity + indexSize + (m_indexCapacity > 0 ? 4 : 0)) {
+			capacity *= 2;
+		}
+		m_indexBuffer = resizeBuffer(m_indexBuffer, m_indexCapacity, capacity);
+		m_indexRanges.addRange(m_indexCapacity, capacity - m_indexCapacity);
+		m_indexCapacity = capacity;
+		glVertexArrayElementBuffer(m_vao, m_indexBuffer);
+	}
+
+	/// <summary>
+	/// Makes the object id attribute valid for baseInstance values below count
+	/// </summary>
+	void GeometryArena::reserveObjectIds(unsigned int count) {
+		if (count <= m_objectIdCapacity) {
+			return;
+		}
+		unsigned int capacity = m_objectIdCapacity > 0 ? m_objectIdCapacity : count;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+		std::vector<uint32_t> ids(capacity);
+		for (unsigned int i = 0; i < capacity; i++)
+		{
+			ids[i] = i;
+		}
+		glDeleteBuffers(1, &m_objectIdBuffer);
+		glCreateBuffers(1, &m_objectIdBuffer);
+		glNamedBufferStorage(m_objectIdBuffer, capacity * sizeof(uint32_t), ids.data(), 0);
+		m_objectIdCapacity = capacity;
+		glVertexArrayVertexBuffer(m_vao, 1, m_objectIdBuffer, 0, sizeof(uint32_t));
+	}
+
+	/// <summary>
+	/// Reserves space, growing the buffers if nothing fits. Index ranges are 4 byte aligned so either index type can use them.
+	/// </summary>
+	bool GeometryArena::allocate(unsigned int numVertices, size_t indexSize, GeometryAllocation* allocation) {
+		size_t firstVertex = 0, indexOffset = 0;
+		if (numVertices > 0 && !m_vertexRanges.allocate(numVertices, 1, &firstVertex)) {
+			growVertices(numVertices);
+			if (!m_vertexRanges.allocate(numVertices, 1, &firstVertex)) {
+				return false;
+			}
+		}
+		if (indexSize > 0 && !m_indexRanges.allocate(indexSize, 4, &indexOffset)) {
+			growIndices(indexSize);
+			if (!m_indexRanges.allocate(indexSize, 4, &indexOffset)) {
+				m_vertexRanges.free(firstVertex, numVertices);
+				return false;
+			}
+		}
+		allocation->firstVertex = (unsigned int)firstVertex;
+		allocation->numVertices = numVertices;
+		allocation->indexOffset = indexOffset;
+		allocation->indexSize = indexSize;
+		m_verticesUsed += numVertices;
+		m_indexBytesUsed += indexSize;
+		m_numAllocations++;
+		return true;
+	}
+
+	void GeometryArena::free(const GeometryAllocation& allocation) {
+		m_vertexRanges.free(allocation.firstVertex, allocation.numVertices);
+		m_indexRanges.free(allocation.indexOffset, allocation.indexSize);
+		m_verticesUsed -= allocation.numVertices;
+		m_indexBytesUsed -= allocation.indexSize;
+		m_numAllocations--;
+	}
+
+	void GeometryArena::upload(const GeometryAllocation& allocation, const void* vertices, const void* indices) {
+		if (allocation.numVertices > 0) {
+			glNamedBufferSubData(m_vertexBuffer, allocation.firstVertex * m_vertexSize, allocation.numVertices * m_vertexSize, vertices);
+		}
+		if (allocation.indexSize > 0) {
+			glNamedBufferSubData(m_indexBuffer, allocation.indexOffset, allocation.indexSize, indices);
+		}
+	}
+
+	GeometryArenaStats GeometryArena::getStats() const {
+		GeometryArenaStats stats;
+		stats.numAllocations = m_numAllocations;
+		stats.vertexCapacity = m_vertexCapacity;
+		stats.verticesUsed = m_verticesUsed;
+		stats.indexCapacity = m_indexCapacity;
+		stats.indexBytesUsed = m_indexBytesUsed;
+		stats.numFreeRanges = (unsigned int)(m_vertexRanges.getNumFreeRanges() + m_indexRanges.getNumFreeRanges());
+		return stats;
+	}
+
+	void GeometryArena::release() {
+		glDeleteVertexArrays(1, &m_vao);
+		//GL may reuse the name, so the shadowed binding can no longer be trusted
+		ew::invalidateGLState();
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		glDeleteBuffers(1, &m_objectIdBuffer);
+		m_vao = m_vertexBuffer = m_indexBuffer = m_objectIdBuffer = 0;
+		m_vertexCapacity = m_objectIdCapacity = 0;
+		m_indexCapacity = 0;
+	}
+
+	//Indexed by VertexFormat. Never destroyed implicitly since the GL context may already be gone at exit.
+	static GeometryArena* s_arenas[NUM_VERTEX_FORMATS] = {};
+
+	GeometryArena& getGeometryArena(VertexFormat format) {
+		GeometryArena*& arena = s_arenas[(int)format];
+		if (arena == nullptr) {
+			arena = new GeometryArena(format, 1 << 16, 1 << 20);
+		}
+		return *arena;
+	}
+
+	/// <summary>
+	/// The arena for a format if anything has created it, else null. For inspecting without creating.
+	/// </summary>
+	const GeometryArena* findGeometryArena(VertexFormat format) {
+		return s_arenas[(int)format];
+	}
+
+	/// <summary>
+	/// Deletes every arena. Meshes allocated from them must not be drawn or released afterwards.
+	/// </summary>
+	void releaseGeometryArenas() {
+		for (GeometryArena*& arena : s_arenas) {
+			if (arena != nullptr) {
+				arena->release();
+				delete arena;
+				arena = nullptr;
+			}
+		}
+	}
+}
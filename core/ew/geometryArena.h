@@ -0,0 +1,74 @@
+#pragma once
+#include "mesh.h"
+#include <map>
+#include <stddef.h>
+
+namespace ew {
+	//Vertex attribute carrying the object index of indirect draws. Instanced with divisor 1 from a 0,1,2,... buffer,
+	//so a command's baseInstance selects the object without GL 4.6 draw parameters.
+	const unsigned int GEOMETRY_ARENA_OBJECT_ATTRIBUTE = 4;
+
+	struct GeometryArenaStats {
+		unsigned int numAllocations = 0;
+		unsigned int vertexCapacity = 0;
+		unsigned int verticesUsed = 0;
+		size_t indexCapacity = 0; //Bytes
+		size_t indexBytesUsed = 0;
+		unsigned int numFreeRanges = 0; //Vertex plus index free list entries; grows with fragmentation
+	};
+
+	/// <summary>
+	/// First fit suballocator over [0, capacity). Freed ranges coalesce with their neighbors.
+	/// </summary>
+	class RangeAllocator {
+	public:
+		void addRange(size_t offset, size_t size);
+		bool allocate(size_t size, size_t alignment, size_t* offset);
+		void free(size_t offset, size_t size);
+		inline size_t getNumFreeRanges()const { return m_free.size(); }
+	private:
+		std::map<size_t, size_t> m_free; //Offset -> size
+	};
+
+	/// <summary>
+	/// One vertex buffer and one index buffer shared by every mesh of a vertex format, with one VAO over both.
+	/// Meshes draw with a base vertex and an index offset, so a whole pass can be a handful of glMultiDrawElementsIndirect calls.
+	/// 16 and 32 bit indices share the index buffer. Buffers double in size when full; allocations keep their offsets.
+	/// </summary>
+	class GeometryArena {
+	public:
+		GeometryArena(VertexFormat format, unsigned int vertexCapacity, size_t indexCapacity);
+		bool allocate(unsigned int numVertices, size_t indexSize, GeometryAllocation* allocation);
+		void free(const GeometryAllocation& allocation);
+		void upload(const GeometryAllocation& allocation, const void* vertices, const void* indices);
+		void reserveObjectIds(unsigned int count);
+		void release();
+		inline unsigned int getVAO()const { return m_vao; }
+		inline VertexFormat getFormat()const { return m_format; }
+		GeometryArenaStats getStats()const;
+	private:
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena& operator=(const GeometryArena&) = delete;
+		void growVertices(unsigned int numVertices);
+		void growIndices(size_t indexSize);
+		VertexFormat m_format;
+		size_t m_vertexSize;
+		unsigned int m_vao = 0;
+		unsigned int m_vertexBuffer = 0;
+		unsigned int m_indexBuffer = 0;
+		unsigned int m_objectIdBuffer = 0;
+		unsigned int m_vertexCapacity = 0;
+		size_t m_indexCapacity = 0;
+		unsigned int m_objectIdCapacity = 0;
+		unsigned int m_verticesUsed = 0;
+		size_t m_indexBytesUsed = 0;
+		unsigned int m_numAllocations = 0;
+		RangeAllocator m_vertexRanges;
+		RangeAllocator m_indexRanges;
+	};
+
+	//Process wide arena per vertex format, created on first use. GL thread only.
+	GeometryArena& getGeometryArena(VertexFormat format);
+	const GeometryArena* findGeometryArena(VertexFormat format);
+	void releaseGeometryArenas();
+}
@@ -0,0 +1,165 @@
+#include "glState.h"
+#include "external/glad.h"
+
+namespace ew {
+	//Shadow value meaning "not known", so the next call always goes through
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+	struct GLStateCache {
+		unsigned int program;
+		unsigned int vao;
+		unsigned int drawFramebuffer;
+		unsigned int readFramebuffer;
+		unsigned int textures[GL_STATE_MAX_TEXTURE_UNITS];
+		unsigned int cullFace;
+		unsigned int cullFaceMode;
+		unsigned int depthTest;
+		unsigned int depthWrite;
+		unsigned int depthFunc;
+	};
+
+	static GLStateCache s_state;
+	static bool s_stateValid = false;
+	static GLStateStats s_frameStats;
+	static GLStateStats s_lastFrameStats;
+
+	/// <summary>
+	/// Updates a shadowed value. Returns false, and counts a skip, if it already held value.
+	/// </summary>
+	static bool changeState(unsigned int* shadow, unsigned int value) {
+		if (!s_stateValid) {
+			invalidateGLState();
+		}
+		if (*shadow == value) {
+			s_frameStats.skipped++;
+			return false;
+		}
+		*shadow = value;
+		s_frameStats.calls++;
+		return true;
+	}
+
+	void useProgram(unsigned int program) {
+		if (changeState(&s_state.program, program)) {
+			glUseProgram(program);
+		}
+	}
+
+	void bindVertexArray(unsigned int vao) {
+		if (changeState(&s_state.vao, vao)) {
+			glBindVertexArray(vao);
+		}
+	}
+
+	/// <summary>
+	/// GL_FRAMEBUFFER binds both the draw and read targets, as in glBindFramebuffer
+	/// </summary>
+	void bindFramebuffer(unsigned int target, unsigned int fbo) {
+		if (target == GL_FRAMEBUFFER) {
+			if (s_stateValid && s_state.drawFramebuffer == fbo && s_state.readFramebuffer == fbo) {
+				s_frameStats.skipped++;
+				return;
+			}
+			if (!s_stateValid) {
+				invalidateGLState();
+			}
+			s_state.drawFramebuffer = s_state.readFramebuffer = fbo;
+			s_frameStats.calls++;
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			return;
+		}
+		unsigned int* shadow = target == GL_READ_FRAMEBUFFER ? &s_state.readFramebuffer : &s_state.drawFramebuffer;
+		if (changeState(shadow, fbo)) {
+			glBindFramebuffer(target, fbo);
+		}
+	}
+
+	void bindTextureUnit(unsigned int unit, unsigned int texture) {
+		if (unit >= GL_STATE_MAX_TEXTURE_UNITS) {
+			s_frameStats.calls++;
+			glBindTextureUnit(unit, texture);
+			return;
+		}
+		if (changeState(&s_state.textures[unit], texture)) {
+			glBindTextureUnit(unit, texture);
+		}
+	}
+
+	void setCullFace(bool enabled) {
+		if (changeState(&s_state.cullFace, enabled ? 1 : 0)) {
+			if (enabled) {
+				glEnable(GL_CULL_FACE);
+			}
+			else {
+				glDisable(GL_CULL_FACE);
+			}
+		}
+	}
+
+	void setCullFaceMode(unsigned int mode) {
+		if (changeState(&s_state.cullFaceMode, mode)) {
+			glCullFace(mode);
+		}
+	}
+
+	void setDepthTest(bool enabled) {
+		if (changeState(&s_state.depthTest, enabled ? 1 : 0)) {
+			if (enabled) {
+				glEnable(GL_DEPTH_TEST);
+			}
+			else {
+				glDisable(GL_DEPTH_TEST);
+			}
+		}
+	}
+
+	void setDepthWrite(bool enabled) {
+		if (changeState(&s_state.depthWrite, enabled ? 1 : 0)) {
+			glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		}
+	}
+
+	void setDepthFunc(unsigned int func) {
+		if (changeState(&s_state.depthFunc, func)) {
+			glDepthFunc(func);
+		}
+	}
+
+	/// <summary>
+	/// Forgets every shadowed value, so the next call of each kind reaches GL.
+	/// Needed after raw GL state changes and after deleting bound objects, whose names GL may hand out again.
+	/// </summary>
+	void invalidateGLState() {
+		s_state.program = UNKNOWN;
+		s_state.vao = UNKNOWN;
+		s_state.drawFramebuffer = UNKNOWN;
+		s_state.readFramebuffer = UNKNOWN;
+		for (unsigned int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++)
+		{
+			s_state.textures[i] = UNKNOWN;
+		}
+		s_state.cullFace = UNKNOWN;
+		s_state.cullFaceMode = UNKNOWN;
+		s_state.depthTest = UNKNOWN;
+		s_state.depthWrite = UNKNOWN;
+		s_state.depthFunc = UNKNOWN;
+		s_stateValid = true;
+	}
+
+	/// <summary>
+	/// Call once per frame before rendering. Publishes the previous frame's stats and
+	/// resyncs with GL, since loaders and UI libraries may have made raw GL calls in between.
+	/// </summary>
+	void beginGLStateFrame() {
+		s_lastFrameStats = s_frameStats;
+		s_frameStats = GLStateStats();
+		invalidateGLState();
+	}
+
+	/// <summary>
+	/// Counts for the last completed frame
+	/// </summary>
+	GLStateStats getGLStateStats() {
+		return s_lastFrameStats;
+	}
+}
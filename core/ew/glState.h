@@ -0,0 +1,27 @@
+#pragma once
+
+namespace ew {
+	struct GLStateStats {
+		unsigned int calls = 0; //State changes that reached GL
+		unsigned int skipped = 0; //Redundant changes filtered out
+	};
+
+	//Texture units above this are passed straight through
+	const unsigned int GL_STATE_MAX_TEXTURE_UNITS = 32;
+
+	//Shadowed GL state. Each call is skipped when it would not change anything. GL thread only.
+	//Code that changes this state with raw GL calls must call invalidateGLState afterwards.
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	void bindFramebuffer(unsigned int target, unsigned int fbo);
+	void bindTextureUnit(unsigned int unit, unsigned int texture);
+	void setCullFace(bool enabled);
+	void setCullFaceMode(unsigned int mode);
+	void setDepthTest(bool enabled);
+	void setDepthWrite(bool enabled);
+	void setDepthFunc(unsigned int func);
+
+	void invalidateGLState();
+	void beginGLStateFrame();
+	GLStateStats getGLStateStats();
+}
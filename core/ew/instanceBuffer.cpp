@@ -0,0 +1,136 @@
+#include "instanceBuffer.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace ew {
+	InstanceBuffer::InstanceBuffer(unsigned int capacity)
+	{
+		reserve(capacity);
+	}
+
+	void InstanceBuffer::reserve(unsigned int capacity)
+	{
+		if (m_buffer == 0) {
+			glCreateBuffers(1, &m_buffer);
+		}
+		m_capacity = capacity;
+		glNamedBufferData(m_buffer, (GLsizeiptr)m_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	}
+
+	/// <summary>
+	/// Replaces the buffer contents with count instances, doubling the capacity if they do not fit
+	/// </summary>
+	void InstanceBuffer::update(const InstanceData* instances, unsigned int count)
+	{
+		if (count > m_capacity || m_buffer == 0) {
+			unsigned int capacity = m_capacity > 0 ? m_capacity : 64;
+			while (capacity < count) {
+				capacity *= 2;
+			}
+			reserve(capacity);
+		}
+		else {
+			//Orphan: the driver hands back fresh storage instead of syncing with pending draws
+			glNamedBufferData(m_buffer, (GLsizeiptr)m_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+		}
+		m_count = count;
+		if (count > 0) {
+			glNamedBufferSubData(m_buffer, 0, (GLsizeiptr)count * sizeof(InstanceData), instances);
+		}
+	}
+
+	void InstanceBuffer::bind(unsigned int binding)const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_buffer);
+	}
+
+	void InstanceBuffer::release()
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		m_capacity = m_count = 0;
+	}
+
+	/// <summary>
+	/// Draws the same instances once with a draw call per instance (two uniform sets each) and once with a single
+	/// instanced call, for several instance counts. Prints the best CPU submission time and GPU time of each.
+	/// Color and depth writes are masked off so the frame being drawn is left untouched.
+	/// </summary>
+	/// <param name="perDrawShader">Reads uniform mat4 _Model and vec3 _Color</param>
+	/// <param name="instancedShader">Reads the InstanceData storage buffer at binding</param>
+	void benchmarkInstancedDraw(const Mesh& mesh, const Shader& perDrawShader, const Shader& instancedShader, unsigned int binding, const glm::mat4& viewProjection, int iterations) {
+		const unsigned int counts[] = { 64, 1024, 16384, 65536 };
+		const unsigned int maxCount = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+		std::vector<InstanceData> instances(maxCount);
+		for (unsigned int i = 0; i < maxCount; i++)
+		{
+			glm::vec3 position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 20.0f - 10.0f;
+			instances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f));
+			instances[i].color = glm::vec4(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX, 1.0f);
+		}
+		InstanceBuffer instanceBuffer(maxCount);
+		UniformHandle<glm::mat4> modelUniform = perDrawShader.getUniform<glm::mat4>("_Model");
+		UniformHandle<glm::vec3> colorUniform = perDrawShader.getUniform<glm::vec3>("_Color");
+		//Timestamps, so this may also be called inside a pass timed with GL_TIME_ELAPSED
+		unsigned int queries[2];
+		glGenQueries(2, queries);
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		ew::setDepthWrite(false);
+		printf("Instancing benchmark: %u indices per instance\n", mesh.getNumIndices());
+		for (unsigned int count : counts)
+		{
+			double bestCpu[2] = { 0.0, 0.0 };
+			double bestGpu[2] = { 0.0, 0.0 };
+			for (int i = 0; i < iterations; i++)
+			{
+				for (int instanced = 0; instanced < 2; instanced++)
+				{
+					glFinish();
+					glQueryCounter(queries[0], GL_TIMESTAMP);
+					auto startTime = std::chrono::high_resolution_clock::now();
+					if (instanced) {
+						instancedShader.use();
+						instancedShader.setMat4("_ViewProjection", viewProjection);
+						instanceBuffer.update(instances.data(), count);
+						instanceBuffer.bind(binding);
+						mesh.drawInstanced(count);
+					}
+					else {
+						perDrawShader.use();
+						perDrawShader.setMat4("_ViewProjection", viewProjection);
+						for (unsigned int j = 0; j < count; j++)
+						{
+							perDrawShader.set(modelUniform, instances[j].model);
+							perDrawShader.set(colorUniform, glm::vec3(instances[j].color));
+							mesh.draw();
+						}
+					}
+					std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - startTime;
+					glQueryCounter(queries[1], GL_TIMESTAMP);
+					GLuint64 gpuStart = 0, gpuEnd = 0;
+					glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &gpuStart);
+					glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &gpuEnd);
+					GLuint64 gpuTime = gpuEnd - gpuStart;
+					if (i == 0 || cpuTime.count() < bestCpu[instanced]) {
+						bestCpu[instanced] = cpuTime.count();
+					}
+					if (i == 0 || gpuTime / 1000000.0 < bestGpu[instanced]) {
+						bestGpu[instanced] = gpuTime / 1000000.0;
+					}
+				}
+			}
+			printf("  %6u instances: per draw %8.3fms cpu %8.3fms gpu | instanced %8.3fms cpu %8.3fms gpu\n",
+				count, bestCpu[0], bestGpu[0], bestCpu[1], bestGpu[1]);
+		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		ew::setDepthWrite(true);
+		glDeleteQueries(2, queries);
+		instanceBuffer.release();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "mesh.h"
+#include "shader.h"
+#include <glm/glm.hpp>
+
+namespace ew {
+	//Per-instance data read by instanced shaders from a storage buffer, indexed by gl_InstanceID:
+	//  struct InstanceData { mat4 model; vec4 color; };
+	//  layout(std430, binding = N) readonly buffer InstanceBuffer { InstanceData _Instances[]; };
+	struct InstanceData {
+		glm::mat4 model = glm::mat4(1.0f);
+		glm::vec4 color = glm::vec4(1.0f);
+	};
+	static_assert(sizeof(InstanceData) == 80, "InstanceData must match the std430 layout");
+
+	/// <summary>
+	/// Storage buffer of InstanceData for Mesh::drawInstanced. Grows on demand and is orphaned on every update,
+	/// so rewriting it each frame never waits on draws still reading last frame's data.
+	/// Plain handle like Mesh: copies share the buffer and release() must be called explicitly.
+	/// </summary>
+	class InstanceBuffer {
+	public:
+		InstanceBuffer() {};
+		InstanceBuffer(unsigned int capacity);
+		void update(const InstanceData* instances, unsigned int count);
+		void bind(unsigned int binding)const;
+		void release();
+		inline unsigned int getCount()const { return m_count; }
+		inline unsigned int getCapacity()const { return m_capacity; }
+	private:
+		void reserve(unsigned int capacity);
+		unsigned int m_buffer = 0;
+		unsigned int m_capacity = 0;
+		unsigned int m_count = 0;
+	};
+
+	void benchmarkInstancedDraw(const Mesh& mesh, const Shader& perDrawShader, const Shader& instancedShader, unsigned int binding, const glm::mat4& viewProjection, int iterations = 5);
+}
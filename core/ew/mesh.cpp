@@ -6,69 +6,196 @@
 */
 
 #include "mesh.h"
+#include "vertexPacking.h"
+#include "meshlet.h"
+#include "glState.h"
+#include "geometryArena.h"
 #include "external/glad.h"
+#include <stdint.h>
+#include <stdio.h>
 
 namespace ew {
+	/// <summary>
+	/// Smallest index type that can address numVertices vertices.
+	/// 8 bit indices are deliberately not used; most drivers convert them to 16 bit on the CPU.
+	/// </summary>
+	IndexType getIndexType(unsigned int numVertices) {
+		return numVertices <= 65536 ? IndexType::UINT16 : IndexType::UINT32;
+	}
+	static GLenum getGLIndexType(IndexType indexType) {
+		return indexType == IndexType::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
+
 	Mesh::Mesh(const MeshData& meshData)
 	{
 		load(meshData);
 	}
 	void Mesh::load(const MeshData& meshData)
 	{
-		if (!m_initialized) {
-			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
-
-			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
-			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
-
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
-
-			// Tangent attribute
-			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, tangent));
-			glEnableVertexAttribArray(2);
-
-			//UV attribute
-			glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(3);
-
-			m_initialized = true;
+		load(meshData.vertices.data(), meshData.vertices.size(), meshData.indices.data(), meshData.indices.size());
+	}
+	/// <summary>
+	/// Uploads raw vertex and 32 bit index arrays. Indices are narrowed to 16 bits when the vertex count allows it.
+	/// </summary>
+	void Mesh::load(const Vertex* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices)
+	{
+		if (ew::getIndexType(numVertices) == IndexType::UINT16) {
+			std::vector<uint16_t> shortIndices(indices, indices + numIndices);
+			load(vertices, numVertices, shortIndices.data(), numIndices, IndexType::UINT16);
 		}
-
-		glBindVertexArray(m_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		else {
+			load(vertices, numVertices, (const void*)indices, numIndices, IndexType::UINT32);
+		}
+	}
+	/// <summary>
+	/// Uploads raw vertex and index arrays as-is. Pointers may point into a memory mapped file.
+	/// </summary>
+	void Mesh::load(const Vertex* vertices, unsigned int numVertices, const void* indices, unsigned int numIndices, IndexType indexType)
+	{
+		m_dequantize = glm::mat4(1.0f);
+		upload(VertexFormat::FULL, vertices, numVertices, indices, numIndices, indexType);
+	}
+	/// <summary>
+	/// Uploads packed vertices (see ew::packVertices) with 32 bit indices, narrowed to 16 bits when possible
+	/// </summary>
+	void Mesh::load(const PackedVertexData& vertices, const unsigned int* indices, unsigned int numIndices)
+	{
+		if (ew::getIndexType(vertices.numVertices) == IndexType::UINT16) {
+			std::vector<uint16_t> shortIndices(indices, indices + numIndices);
+			load(vertices, shortIndices.data(), numIndices, IndexType::UINT16);
 		}
-		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+		else {
+			load(vertices, (const void*)indices, numIndices, IndexType::UINT32);
 		}
-		m_numVertices = meshData.vertices.size();
-		m_numIndices = meshData.indices.size();
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	void Mesh::load(const PackedVertexData& vertices, const void* indices, unsigned int numIndices, IndexType indexType)
+	{
+		load(vertices.format, vertices.bytes.data(), vertices.numVertices, vertices.dequantizeMatrix, indices, numIndices, indexType);
+	}
+	/// <summary>
+	/// Uploads vertices that are already in a given format, e.g. straight out of a mesh cache mapping
+	/// </summary>
+	void Mesh::load(VertexFormat format, const void* vertices, unsigned int numVertices, const glm::mat4& dequantize, const void* indices, unsigned int numIndices, IndexType indexType)
+	{
+		m_dequantize = dequantize;
+		upload(format, vertices, numVertices, indices, numIndices, indexType);
+	}
+	/// <summary>
+	/// Copies the data into the shared arena for this vertex format. Reloading frees the previous allocation first.
+	/// </summary>
+	void Mesh::upload(VertexFormat format, const void* vertices, unsigned int numVertices, const void* indices, unsigned int numIndices, IndexType indexType)
+	{
+		if (m_initialized) {
+			ew::getGeometryArena(m_vertexFormat).free(m_allocation);
+			m_initialized = false;
+		}
+		GeometryArena& arena = ew::getGeometryArena(format);
+		if (!arena.allocate(numVertices, (size_t)indexType * numIndices, &m_allocation)) {
+			printf("Failed to allocate %u vertices and %u indices in the geometry arena\n", numVertices, numIndices);
+			m_numVertices = m_numIndices = 0;
+			return;
+		}
+		arena.upload(m_allocation, vertices, indices);
+		m_vao = arena.getVAO();
+		m_vertexFormat = format;
+		m_numVertices = numVertices;
+		m_numIndices = numIndices;
+		m_indexType = indexType;
+		m_initialized = true;
 	}
 	void Mesh::draw(ew::DrawMode drawMode) const
 	{
-		glBindVertexArray(m_vao);
+		ew::bindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_numIndices, getGLIndexType(m_indexType), (const void*)m_allocation.indexOffset, m_allocation.firstVertex);
+		}
+		else {
+			glDrawArrays(GL_POINTS, m_allocation.firstVertex, m_numVertices);
+		}
+
+	}
+	/// <summary>
+	/// Draws numInstances copies in one call. Per-instance data comes from whatever the shader indexes with gl_InstanceID,
+	/// e.g. an ew::InstanceBuffer bound as a storage buffer.
+	/// </summary>
+	void Mesh::drawInstanced(unsigned int numInstances, ew::DrawMode drawMode) const
+	{
+		if (numInstances == 0) {
+			return;
+		}
+		//Instances also step through the arena's object id attribute, which must cover them
+		ew::getGeometryArena(m_vertexFormat).reserveObjectIds(numInstances);
+		ew::bindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_numIndices, getGLIndexType(m_indexType), (const void*)m_allocation.indexOffset, numInstances, m_allocation.firstVertex);
 		}
 		else {
-			glDrawArrays(GL_POINTS, 0, m_numVertices);
+			glDrawArraysInstanced(GL_POINTS, m_allocation.firstVertex, m_numVertices, numInstances);
+		}
+	}
+	/// <summary>
+	/// Returns the mesh's space to its arena. Mesh is a plain handle that may be copied, so this is never called implicitly.
+	/// </summary>
+	void Mesh::release()
+	{
+		if (!m_initialized) {
+			return;
+		}
+		ew::getGeometryArena(m_vertexFormat).free(m_allocation);
+		m_allocation = GeometryAllocation();
+		m_vao = 0;
+		m_numVertices = m_numIndices = 0;
+		m_meshlets.clear();
+		m_initialized = false;
+	}
+	/// <summary>
+	/// Index ranges must match the uploaded index buffer, i.e. ew::buildMeshlets ran on the indices before load
+	/// </summary>
+	void Mesh::setMeshlets(const Meshlet* meshlets, unsigned int numMeshlets)
+	{
+		m_meshlets.assign(meshlets, meshlets + numMeshlets);
+	}
+	/// <summary>
+	/// Draws only the meshlets that pass ew::isMeshletVisible, in one glMultiDrawElements call.
+	/// Meshes without meshlets draw everything.
+	/// </summary>
+	/// <returns>Number of meshlets drawn</returns>
+	unsigned int Mesh::draw(const MeshletCullView& view) const
+	{
+		if (m_meshlets.empty()) {
+			draw();
+			return 0;
+		}
+		//Scratch for the draw ranges. Only touched from the GL thread.
+		static std::vector<GLsizei> counts;
+		static std::vector<const void*> offsets;
+		static std::vector<GLint> baseVertices;
+		counts.clear();
+		offsets.clear();
+		unsigned int numVisible = 0;
+		unsigned int rangeEnd = 0;
+		for (size_t i = 0; i < m_meshlets.size(); i++)
+		{
+			const Meshlet& meshlet = m_meshlets[i];
+			if (!ew::isMeshletVisible(meshlet, view)) {
+				continue;
+			}
+			numVisible++;
+			//Neighbors in the index buffer merge into one range
+			if (!counts.empty() && rangeEnd == meshlet.firstIndex) {
+				counts.back() += meshlet.numTriangles * 3;
+			}
+			else {
+				counts.push_back(meshlet.numTriangles * 3);
+				offsets.push_back((const void*)(m_allocation.indexOffset + (size_t)meshlet.firstIndex * (size_t)m_indexType));
+			}
+			rangeEnd = meshlet.firstIndex + meshlet.numTriangles * 3;
+		}
+		if (!counts.empty()) {
+			ew::bindVertexArray(m_vao);
+			baseVertices.assign(counts.size(), (GLint)m_allocation.firstVertex);
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), getGLIndexType(m_indexType), offsets.data(), (GLsizei)counts.size(), baseVertices.data());
 		}
-		
+		return numVisible;
 	}
 }
\ No newline at end of file
@@ -8,10 +8,10 @@
 
 namespace ew {
 	struct Vertex {
-		glm::vec3 pos;
-		glm::vec3 normal;
-		glm::vec3 tangent;
-		glm::vec2 uv;
+		glm::vec3 pos = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		glm::vec3 tangent = glm::vec3(0.0f);
+		glm::vec2 uv = glm::vec2(0.0f);
 	};
 
 	struct MeshData {
@@ -19,6 +19,53 @@ namespace ew {
 		std::vector<unsigned int> indices;
 	};
 
+	//Bytes per index. Meshes store the smallest type that can address all of their vertices.
+	enum class IndexType {
+		UINT16 = 2,
+		UINT32 = 4
+	};
+	IndexType getIndexType(unsigned int numVertices);
+
+	//Vertex layouts Mesh can upload. Packed formats are produced by ew::packVertices (vertexPacking.h).
+	enum class VertexFormat {
+		FULL = 0, //ew::Vertex, 44 bytes
+		PACKED = 1, //ew::PackedVertex, 24 bytes. Float positions keep it just over half of FULL
+		PACKED_QUANTIZED = 2 //ew::QuantizedVertex, 20 bytes. Needs Mesh::getDequantizationMatrix
+	};
+	const unsigned int NUM_VERTEX_FORMATS = 3;
+	struct PackedVertexData;
+
+	//A run of triangles in its mesh's index buffer, with bounds for culling. Built by ew::buildMeshlets (meshlet.h).
+	//Plain data so it can live in the mesh cache.
+	struct Meshlet {
+		unsigned int firstIndex; //Into the mesh's index buffer
+		unsigned int numTriangles;
+		unsigned int numVertices; //Unique vertices referenced
+		float coneCutoff; //Backface cone, see ew::isMeshletVisible. 1 with a zero axis when the triangles face too many ways to cull
+		glm::vec3 coneAxis;
+		glm::vec3 center; //Bounding sphere
+		float radius;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	//Camera and frustum moved into a mesh's object space, from ew::createMeshletCullView. Assumes uniform scale.
+	struct MeshletCullView {
+		glm::vec4 frustumPlanes[6]; //Normalized, positive inside
+		glm::vec3 position = glm::vec3(0.0f); //Eye, for perspective cameras
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); //View direction, for orthographic cameras
+		bool orthographic = false;
+		bool cullFrontFaces = false; //For passes drawn with glCullFace(GL_FRONT), e.g. shadow maps
+	};
+
+	//Where a mesh lives inside the shared buffers of its ew::GeometryArena (geometryArena.h)
+	struct GeometryAllocation {
+		unsigned int firstVertex = 0;
+		unsigned int numVertices = 0;
+		size_t indexOffset = 0; //Bytes into the index buffer, aligned to 4
+		size_t indexSize = 0; //Bytes
+	};
+
 	enum class DrawMode {
 		TRIANGLES = 0,
 		POINTS = 1
@@ -29,15 +76,37 @@ namespace ew {
 		Mesh() {};
 		Mesh(const MeshData& meshData);
 		void load(const MeshData& meshData);
+		void load(const Vertex* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices);
+		void load(const Vertex* vertices, unsigned int numVertices, const void* indices, unsigned int numIndices, IndexType indexType);
+		void load(const PackedVertexData& vertices, const unsigned int* indices, unsigned int numIndices);
+		void load(const PackedVertexData& vertices, const void* indices, unsigned int numIndices, IndexType indexType);
+		void load(VertexFormat format, const void* vertices, unsigned int numVertices, const glm::mat4& dequantize, const void* indices, unsigned int numIndices, IndexType indexType);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		unsigned int draw(const MeshletCullView& view)const;
+		void drawInstanced(unsigned int numInstances, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		void setMeshlets(const Meshlet* meshlets, unsigned int numMeshlets);
+		void release();
+		inline const std::vector<Meshlet>& getMeshlets()const { return m_meshlets; }
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		inline IndexType getIndexType()const { return m_indexType; }
+		inline VertexFormat getVertexFormat()const { return m_vertexFormat; }
+		//Multiply into the model matrix when drawing PACKED_QUANTIZED meshes. Identity otherwise.
+		inline const glm::mat4& getDequantizationMatrix()const { return m_dequantize; }
+		//Offsets for drawing from the arena's buffers, e.g. in an indirect command
+		inline unsigned int getVAO()const { return m_vao; }
+		inline unsigned int getBaseVertex()const { return m_allocation.firstVertex; }
+		inline unsigned int getFirstIndex()const { return (unsigned int)(m_allocation.indexOffset / (size_t)m_indexType); }
 	private:
+		void upload(VertexFormat format, const void* vertices, unsigned int numVertices, const void* indices, unsigned int numIndices, IndexType indexType);
 		bool m_initialized = false;
-		unsigned int m_vao = 0;
-		unsigned int m_vbo = 0;
-		unsigned int m_ebo = 0;
+		unsigned int m_vao = 0; //The arena's, shared with every mesh of this vertex format
+		GeometryAllocation m_allocation;
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		IndexType m_indexType = IndexType::UINT32;
+		VertexFormat m_vertexFormat = VertexFormat::FULL;
+		glm::mat4 m_dequantize = glm::mat4(1.0f);
+		std::vector<Meshlet> m_meshlets;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include "meshCache.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	static const size_t MESH_CACHE_ALIGNMENT = 16;
+
+	static size_t alignOffset(size_t offset) {
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	//FNV-1a, only used to detect a cache that was written for a different source file
+	static uint64_t hashString(const std::string& str) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < str.size(); i++)
+		{
+			hash ^= (unsigned char)str[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Returns last modification time of a file, or -1 if it does not exist
+	/// </summary>
+	static int64_t getFileModifiedTime(const std::string& filePath) {
+		struct stat fileStat;
+		if (stat(filePath.c_str(), &fileStat) != 0) {
+			return -1;
+		}
+		return (int64_t)fileStat.st_mtime;
+	}
+
+	MeshCacheFile::~MeshCacheFile()
+	{
+		close();
+	}
+
+	/// <summary>
+	/// Maps a cache file into memory and validates its layout. Does not check it against a source file.
+	/// </summary>
+	/// <param name="cachePath">Path to .ewmesh file</param>
+	/// <returns>True if file was mapped and is structurally valid</returns>
+	bool MeshCacheFile::open(const std::string& cachePath)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (mapping == NULL) {
+			return false;
+		}
+		//The view keeps the mapping alive, so both handles can be closed right away
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (view == NULL) {
+			return false;
+		}
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)fileSize.QuadPart;
+#else
+		int fd = ::open(cachePath.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)fileStat.st_size;
+#endif
+		//Reject truncated or foreign files before anyone dereferences into them
+		bool valid = m_size >= sizeof(MeshCacheHeader);
+		if (valid) {
+			const MeshCacheHeader& header = getHeader();
+			valid = header.magic == MESH_CACHE_MAGIC
+				&& header.version == MESH_CACHE_VERSION
+				&& header.vertexFormat <= (uint32_t)VertexFormat::PACKED_QUANTIZED
+				&& header.vertexSize == getVertexSize((VertexFormat)header.vertexFormat)
+				&& m_size >= sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * (size_t)header.numMeshes;
+		}
+		for (unsigned int i = 0; valid && i < getNumMeshes(); i++)
+		{
+			const MeshCacheEntry& entry = getEntry(i);
+			valid = entry.vertexOffset + getHeader().vertexSize * (uint64_t)entry.numVertices <= m_size
+				&& (entry.indexSize == (uint32_t)IndexType::UINT16 || entry.indexSize == (uint32_t)IndexType::UINT32)
+				&& entry.indexOffset + entry.indexSize * (uint64_t)entry.numIndices <= m_size
+				&& entry.meshletOffset + sizeof(Meshlet) * (uint64_t)entry.numMeshlets <= m_size;
+		}
+		if (!valid) {
+			close();
+		}
+		return valid;
+	}
+
+	void MeshCacheFile::close()
+	{
+		if (m_data == nullptr) {
+			return;
+		}
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap((void*)m_data, m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	const MeshCacheHeader& MeshCacheFile::getHeader() const
+	{
+		return *(const MeshCacheHeader*)m_data;
+	}
+
+	unsigned int MeshCacheFile::getNumMeshes() const
+	{
+		return isOpen() ? getHeader().numMeshes : 0;
+	}
+
+	const MeshCacheEntry& MeshCacheFile::getEntry(unsigned int meshIndex) const
+	{
+		const MeshCacheEntry* entries = (const MeshCacheEntry*)(m_data + sizeof(MeshCacheHeader));
+		return entries[meshIndex];
+	}
+
+	/// <summary>
+	/// Full vertices of one mesh. Null when the cache was written in a packed format, see getVertexData.
+	/// </summary>
+	const Vertex* MeshCacheFile::getVertices(unsigned int meshIndex) const
+	{
+		return getVertexFormat() == VertexFormat::FULL ? (const Vertex*)getVertexData(meshIndex) : nullptr;
+	}
+
+	/// <summary>
+	/// Vertices of one mesh in the cache's vertex format
+	/// </summary>
+	const void* MeshCacheFile::getVertexData(unsigned int meshIndex) const
+	{
+		return m_data + getEntry(meshIndex).vertexOffset;
+	}
+
+	VertexFormat MeshCacheFile::getVertexFormat() const
+	{
+		return (VertexFormat)getHeader().vertexFormat;
+	}
+
+	/// <summary>
+	/// Bounds over every mesh, measured on the unpacked positions
+	/// </summary>
+	void MeshCacheFile::getBounds(glm::vec3* boundsMin, glm::vec3* boundsMax) const
+	{
+		*boundsMin = glm::make_vec3(getHeader().boundsMin);
+		*boundsMax = glm::make_vec3(getHeader().boundsMax);
+	}
+
+	glm::mat4 MeshCacheFile::getDequantizationMatrix() const
+	{
+		return glm::make_mat4(getHeader().dequantizeMatrix);
+	}
+
+	const void* MeshCacheFile::getIndices(unsigned int meshIndex) const
+	{
+		return m_data + getEntry(meshIndex).indexOffset;
+	}
+
+	IndexType MeshCacheFile::getIndexType(unsigned int meshIndex) const
+	{
+		return (IndexType)getEntry(meshIndex).indexSize;
+	}
+
+	MeshLODInfo MeshCacheFile::getLODInfo(unsigned int meshIndex) const
+	{
+		MeshLODInfo lodInfo;
+		lodInfo.level = getEntry(meshIndex).lodLevel;
+		lodInfo.error = getEntry(meshIndex).lodError;
+		return lodInfo;
+	}
+
+	/// <summary>
+	/// Meshlets for one mesh, or null if none were written
+	/// </summary>
+	const Meshlet* MeshCacheFile::getMeshlets(unsigned int meshIndex) const
+	{
+		const MeshCacheEntry& entry = getEntry(meshIndex);
+		return entry.numMeshlets > 0 ? (const Meshlet*)(m_data + entry.meshletOffset) : nullptr;
+	}
+
+	/// <summary>
+	/// Builds the processFlags cache key for a model load
+	/// </summary>
+	/// <param name="optimize">ew::optimizeMesh was run after import</param>
+	/// <param name="meshlets">ew::buildMeshlets was run after import</param>
+	/// <param name="numLODs">Levels in the chain, including full detail. 1 means no LODs</param>
+	/// <param name="lodReduction">Triangle ratio between consecutive levels, stored to 1% precision</param>
+	unsigned int getMeshProcessFlags(bool optimize, bool meshlets, unsigned int numLODs, float lodReduction) {
+		unsigned int flags = optimize ? MESH_PROCESS_OPTIMIZE : MESH_PROCESS_NONE;
+		if (meshlets) {
+			flags |= MESH_PROCESS_MESHLETS;
+		}
+		if (numLODs > 1) {
+			flags |= (std::min(numLODs, 255u) << 8) | ((unsigned int)(lodReduction * 100.0f + 0.5f) & 0xFF) << 16;
+		}
+		return flags;
+	}
+
+	/// <summary>
+	/// Cache files live next to their source, e.g. assets/suzanne.fbx -> assets/suzanne.fbx.ewmesh
+	/// </summary>
+	std::string getMeshCachePath(const std::string& sourcePath) {
+		return sourcePath + ".ewmesh";
+	}
+
+	/// <summary>
+	/// Opens the cache for a source model if it exists and was written for the same file, modification time and flags.
+	/// </summary>
+	/// <param name="sourcePath">Path to the source model file (.fbx, .obj, etc.)</param>
+	/// <param name="importFlags">Assimp post process flags used to import the source</param>
+	/// <param name="processFlags">MeshProcessFlags applied after import</param>
+	/// <param name="vertexFormat">Format the vertices must be stored in</param>
+	/// <param name="cache">Cache file to map into</param>
+	/// <returns>True on cache hit</returns>
+	bool openMeshCache(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags, VertexFormat vertexFormat, MeshCacheFile* cache) {
+		int64_t modifiedTime = getFileModifiedTime(sourcePath);
+		if (modifiedTime < 0) {
+			return false;
+		}
+		if (!cache->open(getMeshCachePath(sourcePath))) {
+			return false;
+		}
+		const MeshCacheHeader& header = cache->getHeader();
+		if (header.sourcePathHash != hashString(sourcePath)
+			|| header.sourceModifiedTime != modifiedTime
+			|| header.importFlags != importFlags
+			|| header.processFlags != processFlags
+			|| header.vertexFormat != (uint32_t)vertexFormat) {
+			cache->close();
+			return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Writes converted meshes for a source model to its cache file
+	/// </summary>
+	/// <param name="sourcePath">Path to the source model file</param>
+	/// <param name="importFlags">Assimp post process flags used to import the source</param>
+	/// <param name="processFlags">MeshProcessFlags applied after import</param>
+	/// <param name="meshes">Converted meshes, in scene order</param>
+	/// <param name="lodInfos">Optional. LOD level and error of each mesh. Null writes every mesh as level 0</param>
+	/// <param name="meshlets">Optional. Meshlets of each mesh, matching its index order</param>
+	/// <param name="packedVertices">Optional. Packed vertices of each mesh, all in one format, written instead of MeshData::vertices</param>
+	/// <returns>True if the whole file was written</returns>
+	bool writeMeshCache(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags, const std::vector<MeshData>& meshes, const std::vector<MeshLODInfo>* lodInfos, const std::vector<std::vector<Meshlet>>* meshlets, const std::vector<PackedVertexData>* packedVertices) {
+		MeshCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.sourcePathHash = hashString(sourcePath);
+		header.sourceModifiedTime = getFileModifiedTime(sourcePath);
+		header.importFlags = importFlags;
+		header.processFlags = processFlags;
+		header.numMeshes = (uint32_t)meshes.size();
+		VertexFormat vertexFormat = packedVertices && !packedVertices->empty() ? (*packedVertices)[0].format : VertexFormat::FULL;
+		glm::mat4 dequantize = packedVertices && !packedVertices->empty() ? (*packedVertices)[0].dequantizeMatrix : glm::mat4(1.0f);
+		header.vertexFormat = (uint32_t)vertexFormat;
+		header.vertexSize = (uint32_t)getVertexSize(vertexFormat);
+		memcpy(header.dequantizeMatrix, glm::value_ptr(dequantize), sizeof(header.dequantizeMatrix));
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		bool hasBounds = false;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			for (size_t j = 0; j < meshes[i].vertices.size(); j++)
+			{
+				const glm::vec3& pos = meshes[i].vertices[j].pos;
+				boundsMin = hasBounds ? glm::min(boundsMin, pos) : pos;
+				boundsMax = hasBounds ? glm::max(boundsMax, pos) : pos;
+				hasBounds = true;
+			}
+		}
+		memcpy(header.boundsMin, glm::value_ptr(boundsMin), sizeof(header.boundsMin));
+		memcpy(header.boundsMax, glm::value_ptr(boundsMax), sizeof(header.boundsMax));
+
+		//Lay out blobs after the entry table
+		std::vector<MeshCacheEntry> entries(meshes.size());
+		size_t offset = sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * entries.size();
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			memset(&entries[i], 0, sizeof(MeshCacheEntry));
+			entries[i].numVertices = (uint32_t)meshes[i].vertices.size();
+			entries[i].numIndices = (uint32_t)meshes[i].indices.size();
+			entries[i].indexSize = (uint32_t)ew::getIndexType(entries[i].numVertices);
+			if (lodInfos) {
+				entries[i].lodLevel = (*lodInfos)[i].level;
+				entries[i].lodError = (*lodInfos)[i].error;
+			}
+			offset = alignOffset(offset);
+			entries[i].vertexOffset = offset;
+			offset += header.vertexSize * meshes[i].vertices.size();
+			offset = alignOffset(offset);
+			entries[i].indexOffset = offset;
+			offset += entries[i].indexSize * meshes[i].indices.size();
+			if (meshlets && !(*meshlets)[i].empty()) {
+				offset = alignOffset(offset);
+				entries[i].meshletOffset = offset;
+				entries[i].numMeshlets = (uint32_t)(*meshlets)[i].size();
+				offset += sizeof(Meshlet) * (*meshlets)[i].size();
+			}
+		}
+
+		std::string cachePath = getMeshCachePath(sourcePath);
+		FILE* file = fopen(cachePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write mesh cache %s\n", cachePath.c_str());
+			return false;
+		}
+		const unsigned char padding[MESH_CACHE_ALIGNMENT] = {};
+		bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+		if (!entries.empty()) {
+			success = success && fwrite(entries.data(), sizeof(MeshCacheEntry), entries.size(), file) == entries.size();
+		}
+		size_t written = sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * entries.size();
+		for (size_t i = 0; success && i < meshes.size(); i++)
+		{
+			size_t vertexPad = entries[i].vertexOffset - written;
+			success = fwrite(padding, 1, vertexPad, file) == vertexPad;
+			const void* vertices = vertexFormat == VertexFormat::FULL ? (const void*)meshes[i].vertices.data() : (const void*)(*packedVertices)[i].bytes.data();
+			success = success && fwrite(vertices, header.vertexSize, meshes[i].vertices.size(), file) == meshes[i].vertices.size();
+			written = entries[i].vertexOffset + header.vertexSize * meshes[i].vertices.size();
+
+			size_t indexPad = entries[i].indexOffset - written;
+			success = success && fwrite(padding, 1, indexPad, file) == indexPad;
+			//Store indices at the width Mesh will upload them, so loading needs no conversion
+			if (entries[i].indexSize == (uint32_t)IndexType::UINT16) {
+				std::vector<uint16_t> shortIndices(meshes[i].indices.begin(), meshes[i].indices.end());
+				success = success && fwrite(shortIndices.data(), sizeof(uint16_t), shortIndices.size(), file) == shortIndices.size();
+			}
+			else {
+				success = success && fwrite(meshes[i].indices.data(), sizeof(unsigned int), meshes[i].indices.size(), file) == meshes[i].indices.size();
+			}
+			written = entries[i].indexOffset + entries[i].indexSize * meshes[i].indices.size();
+
+			if (entries[i].numMeshlets > 0) {
+				size_t meshletPad = entries[i].meshletOffset - written;
+				success = success && fwrite(padding, 1, meshletPad, file) == meshletPad;
+				success = success && fwrite((*meshlets)[i].data(), sizeof(Meshlet), (*meshlets)[i].size(), file) == (*meshlets)[i].size();
+				written = entries[i].meshletOffset + sizeof(Meshlet) * (*meshlets)[i].size();
+			}
+		}
+		fclose(file);
+		if (!success) {
+			//Never leave a half written cache behind
+			remove(cachePath.c_str());
+			printf("Failed to write mesh cache %s\n", cachePath.c_str());
+		}
+		return success;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "mesh.h"
+#include "vertexPacking.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ew {
+	const uint32_t MESH_CACHE_MAGIC = 0x4843574D; // "MWCH"
+	const uint32_t MESH_CACHE_VERSION = 5;
+
+	//Processing done by ew after Assimp import. Part of the cache key alongside the Assimp flags.
+	enum MeshProcessFlags {
+		MESH_PROCESS_NONE = 0,
+		MESH_PROCESS_OPTIMIZE = 1 << 0, //ew::optimizeMesh
+		MESH_PROCESS_MESHLETS = 1 << 1 //ew::buildMeshlets
+	};
+	//LOD settings are packed above the flags so a different chain is a cache miss
+	unsigned int getMeshProcessFlags(bool optimize, bool meshlets, unsigned int numLODs, float lodReduction);
+
+	//Where a cached mesh sits in its model's LOD chain
+	struct MeshLODInfo {
+		uint32_t level = 0; //0 is full detail
+		float error = 0.0f; //Object space error from ew::simplifyMesh, accumulated down the chain
+	};
+
+	//On-disk layout: MeshCacheHeader, numMeshes x MeshCacheEntry, then the vertex, index and meshlet blobs.
+	//Blobs are 16 byte aligned so they can be handed to glBufferData straight from the mapping.
+	//Vertex blobs are stored already packed to vertexFormat, so warm loads skip ew::packVertices.
+	struct MeshCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourcePathHash;
+		int64_t sourceModifiedTime;
+		uint32_t importFlags;
+		uint32_t vertexSize; //ew::getVertexSize(vertexFormat) when written
+		uint32_t numMeshes;
+		uint32_t processFlags; //MeshProcessFlags applied after import
+		uint32_t vertexFormat; //ew::VertexFormat of the vertex blobs
+		float boundsMin[3]; //Over every mesh, before packing
+		float boundsMax[3];
+		float dequantizeMatrix[16]; //Shared by every mesh. Identity unless PACKED_QUANTIZED
+	};
+
+	struct MeshCacheEntry {
+		uint64_t vertexOffset; //Byte offset from start of file
+		uint64_t indexOffset;
+		uint64_t meshletOffset; //ew::Meshlet array, only when numMeshlets > 0
+		uint32_t numVertices;
+		uint32_t numIndices;
+		uint32_t indexSize; //ew::IndexType, 2 or 4 bytes
+		uint32_t lodLevel;
+		float lodError;
+		uint32_t numMeshlets;
+	};
+
+	/// <summary>
+	/// Read-only memory mapped view of a mesh cache file.
+	/// Vertex and index pointers are valid until close() or destruction.
+	/// </summary>
+	class MeshCacheFile {
+	public:
+		MeshCacheFile() {};
+		~MeshCacheFile();
+		bool open(const std::string& cachePath);
+		void close();
+		inline bool isOpen()const { return m_data != nullptr; }
+		unsigned int getNumMeshes()const;
+		const MeshCacheEntry& getEntry(unsigned int meshIndex)const;
+		const Vertex* getVertices(unsigned int meshIndex)const;
+		const void* getVertexData(unsigned int meshIndex)const;
+		VertexFormat getVertexFormat()const;
+		void getBounds(glm::vec3* boundsMin, glm::vec3* boundsMax)const;
+		glm::mat4 getDequantizationMatrix()const;
+		const void* getIndices(unsigned int meshIndex)const;
+		IndexType getIndexType(unsigned int meshIndex)const;
+		MeshLODInfo getLODInfo(unsigned int meshIndex)const;
+		const Meshlet* getMeshlets(unsigned int meshIndex)const;
+		const MeshCacheHeader& getHeader()const;
+	private:
+		MeshCacheFile(const MeshCacheFile&) = delete;
+		MeshCacheFile& operator=(const MeshCacheFile&) = delete;
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+	std::string getMeshCachePath(const std::string& sourcePath);
+	bool openMeshCache(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags, VertexFormat vertexFormat, MeshCacheFile* cache);
+	bool writeMeshCache(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags, const std::vector<MeshData>& meshes, const std::vector<MeshLODInfo>* lodInfos = nullptr, const std::vector<std::vector<Meshlet>>* meshlets = nullptr, const std::vector<PackedVertexData>* packedVertices = nullptr);
+}
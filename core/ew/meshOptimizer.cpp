@@ -0,0 +1,366 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace ew {
+	/// <summary>
+	/// Simulates a FIFO post-transform cache over an index buffer
+	/// </summary>
+	/// <param name="indices">Triangle list indices</param>
+	/// <param name="numIndices">Number of indices</param>
+	/// <param name="numVertices">Size of the vertex buffer the indices point into</param>
+	/// <param name="cacheSize">Number of FIFO entries</param>
+	/// <returns>ACMR/ATVR of the given order</returns>
+	VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t numIndices, size_t numVertices, unsigned int cacheSize) {
+		VertexCacheStats stats;
+		if (numIndices < 3 || numVertices == 0) {
+			return stats;
+		}
+		//A vertex is in the FIFO while fewer than cacheSize misses have happened since it was inserted
+		std::vector<unsigned int> insertedAt(numVertices, 0);
+		std::vector<bool> referenced(numVertices, false);
+		unsigned int misses = 0;
+		unsigned int numUnique = 0;
+		for (size_t i = 0; i < numIndices; i++)
+		{
+			unsigned int v = indices[i];
+			if (!referenced[v]) {
+				referenced[v] = true;
+				numUnique++;
+			}
+			if (insertedAt[v] == 0 || misses - insertedAt[v] >= cacheSize) {
+				misses++;
+				insertedAt[v] = misses;
+			}
+		}
+		stats.numTransformed = misses;
+		stats.acmr = (float)misses / (numIndices / 3);
+		stats.atvr = (float)misses / numUnique;
+		return stats;
+	}
+
+	struct VertexHasher {
+		size_t operator()(const Vertex& v) const {
+			//Adding 0 folds -0.0 into +0.0 so values that compare equal hash equal
+			const float values[11] = {
+				v.pos.x + 0.0f, v.pos.y + 0.0f, v.pos.z + 0.0f,
+				v.normal.x + 0.0f, v.normal.y + 0.0f, v.normal.z + 0.0f,
+				v.tangent.x + 0.0f, v.tangent.y + 0.0f, v.tangent.z + 0.0f,
+				v.uv.x + 0.0f, v.uv.y + 0.0f
+			};
+			unsigned int bits[11];
+			memcpy(bits, values, sizeof(bits));
+			size_t hash = 14695981039346656037ull;
+			for (int i = 0; i < 11; i++)
+			{
+				hash ^= bits[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	struct VertexEqual {
+		bool operator()(const Vertex& a, const Vertex& b) const {
+			return a.pos == b.pos && a.normal == b.normal && a.tangent == b.tangent && a.uv == b.uv;
+		}
+	};
+
+	/// <summary>
+	/// Merges vertices with identical attributes and rewrites indices to match
+	/// </summary>
+	/// <param name="mesh">Mesh to weld in place</param>
+	/// <returns>Number of vertices removed</returns>
+	unsigned int weldVertices(MeshData* mesh) {
+		std::unordered_map<Vertex, unsigned int, VertexHasher, VertexEqual> uniqueVertices;
+		uniqueVertices.reserve(mesh->vertices.size());
+		std::vector<unsigned int> remap(mesh->vertices.size());
+		std::vector<Vertex> welded;
+		welded.reserve(mesh->vertices.size());
+		for (size_t i = 0; i < mesh->vertices.size(); i++)
+		{
+			auto result = uniqueVertices.insert(std::make_pair(mesh->vertices[i], (unsigned int)welded.size()));
+			if (result.second) {
+				welded.push_back(mesh->vertices[i]);
+			}
+			remap[i] = result.first->second;
+		}
+		for (size_t i = 0; i < mesh->indices.size(); i++)
+		{
+			mesh->indices[i] = remap[mesh->indices[i]];
+		}
+		unsigned int numRemoved = (unsigned int)(mesh->vertices.size() - welded.size());
+		mesh->vertices.swap(welded);
+		return numRemoved;
+	}
+
+	/// <summary>
+	/// Reorders triangles for post-transform cache locality using Tipsify (Sander, Nehab, Barczak 2007).
+	/// </summary>
+	/// <param name="mesh">Mesh whose indices are reordered in place</param>
+	/// <param name="clusterStarts">Optional. Receives the first triangle of every cluster (where the fan hit a dead end), for optimizeOverdraw</param>
+	void optimizeVertexCache(MeshData* mesh, std::vector<unsigned int>* clusterStarts) {
+		const size_t numVertices = mesh->vertices.size();
+		const size_t numTriangles = mesh->indices.size() / 3;
+		if (clusterStarts) {
+			clusterStarts->clear();
+		}
+		if (numTriangles == 0) {
+			return;
+		}
+		const std::vector<unsigned int>& indices = mesh->indices;
+		const int cacheSize = (int)VERTEX_CACHE_SIZE;
+
+		//Vertex -> triangle adjacency in CSR form
+		std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			adjacencyOffsets[indices[i] + 1]++;
+		}
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		std::vector<unsigned int> adjacency(numTriangles * 3);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<int> liveTriangles(numVertices);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			liveTriangles[i] = (int)(adjacencyOffsets[i + 1] - adjacencyOffsets[i]);
+		}
+		std::vector<int> cacheTime(numVertices, 0);
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<unsigned int> deadEndStack;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(numTriangles * 3);
+
+		int time = cacheSize + 1;
+		size_t cursor = 0; //Next vertex to try in input order once the dead end stack is exhausted
+		int fanVertex = (int)indices[0];
+		if (clusterStarts) {
+			clusterStarts->push_back(0);
+		}
+		while (fanVertex >= 0) {
+			candidates.clear();
+			for (unsigned int a = adjacencyOffsets[fanVertex]; a < adjacencyOffsets[fanVertex + 1]; a++)
+			{
+				unsigned int triangle = adjacency[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[triangle * 3 + k];
+					output.push_back(v);
+					deadEndStack.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (time - cacheTime[v] > cacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			//Prefer the candidate that will still be in cache after its remaining triangles are emitted, oldest first
+			int bestVertex = -1;
+			int bestPriority = -1;
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				unsigned int v = candidates[c];
+				if (liveTriangles[v] <= 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+					priority = time - cacheTime[v];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					bestVertex = (int)v;
+				}
+			}
+
+			if (bestVertex < 0) {
+				//Dead end: recently used vertices first, then fall back to input order
+				while (!deadEndStack.empty()) {
+					unsigned int v = deadEndStack.back();
+					deadEndStack.pop_back();
+					if (liveTriangles[v] > 0) {
+						bestVertex = (int)v;
+						break;
+					}
+				}
+				while (bestVertex < 0 && cursor < numVertices) {
+					if (liveTriangles[cursor] > 0) {
+						bestVertex = (int)cursor;
+					}
+					cursor++;
+				}
+				if (bestVertex >= 0 && clusterStarts) {
+					clusterStarts->push_back((unsigned int)(output.size() / 3));
+				}
+			}
+			fanVertex = bestVertex;
+		}
+		mesh->indices.swap(output);
+	}
+
+	/// <summary>
+	/// Reorders clusters of triangles so that outward facing clusters draw first, reducing overdraw
+	/// without giving up much of the vertex cache order. Call after optimizeVertexCache.
+	/// </summary>
+	/// <param name="mesh">Mesh whose indices are reordered in place</param>
+	/// <param name="clusterStarts">Cluster boundaries from optimizeVertexCache</param>
+	/// <param name="threshold">Clusters are split further wherever their own ACMR is within this factor of the whole mesh's</param>
+	void optimizeOverdraw(MeshData* mesh, const std::vector<unsigned int>& clusterStarts, float threshold) {
+		const std::vector<unsigned int>& indices = mesh->indices;
+		const unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+		if (numTriangles == 0 || clusterStarts.empty()) {
+			return;
+		}
+		const float meshAcmr = analyzeVertexCache(indices.data(), indices.size(), mesh->vertices.size()).acmr;
+
+		//Split hard clusters into soft ones wherever restarting with a cold cache costs little
+		std::vector<unsigned int> splits;
+		//insertedAt stamps persist across clusters, so the miss counter keeps running too; a fresh missBase makes each start cold
+		std::vector<unsigned int> insertedAt(mesh->vertices.size(), 0);
+		unsigned int misses = 0;
+		for (size_t c = 0; c < clusterStarts.size(); c++)
+		{
+			unsigned int start = clusterStarts[c];
+			unsigned int end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : numTriangles;
+			splits.push_back(start);
+			unsigned int missBase = misses; //Miss counter value at the split, so the FIFO starts cold there
+			unsigned int splitStart = start;
+			for (unsigned int t = start; t < end; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[t * 3 + k];
+					if (insertedAt[v] <= missBase || misses - insertedAt[v] >= VERTEX_CACHE_SIZE) {
+						misses++;
+						insertedAt[v] = misses;
+					}
+				}
+				unsigned int numClusterTriangles = t + 1 - splitStart;
+				if (t + 1 < end && numClusterTriangles >= VERTEX_CACHE_SIZE
+					&& (float)(misses - missBase) / numClusterTriangles <= meshAcmr * threshold) {
+					splits.push_back(t + 1);
+					splitStart = t + 1;
+					missBase = misses;
+				}
+			}
+		}
+
+		//Sort clusters by how far their area weighted normal points away from the mesh center
+		glm::vec3 meshCentroid = glm::vec3(0.0f);
+		float meshArea = 0.0f;
+		struct Cluster {
+			unsigned int start, end;
+			float sortKey;
+		};
+		std::vector<Cluster> clusters(splits.size());
+		std::vector<glm::vec3> clusterCentroids(splits.size());
+		std::vector<glm::vec3> clusterNormals(splits.size());
+		for (size_t c = 0; c < splits.size(); c++)
+		{
+			clusters[c].start = splits[c];
+			clusters[c].end = c + 1 < splits.size() ? splits[c + 1] : numTriangles;
+			glm::vec3 centroid = glm::vec3(0.0f);
+			glm::vec3 normal = glm::vec3(0.0f);
+			float area = 0.0f;
+			for (unsigned int t = clusters[c].start; t < clusters[c].end; t++)
+			{
+				const glm::vec3& p0 = mesh->vertices[indices[t * 3 + 0]].pos;
+				const glm::vec3& p1 = mesh->vertices[indices[t * 3 + 1]].pos;
+				const glm::vec3& p2 = mesh->vertices[indices[t * 3 + 2]].pos;
+				glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0); //Length is twice the area
+				float faceArea = glm::length(faceNormal);
+				centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+				normal += faceNormal;
+				area += faceArea;
+			}
+			meshCentroid += centroid;
+			meshArea += area;
+			clusterCentroids[c] = area > 0.0f ? centroid / area : mesh->vertices[indices[clusters[c].start * 3]].pos;
+			float normalLength = glm::length(normal);
+			clusterNormals[c] = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+		}
+		if (meshArea > 0.0f) {
+			meshCentroid /= meshArea;
+		}
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			clusters[c].sortKey = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			output.insert(output.end(), indices.begin() + clusters[c].start * 3, indices.begin() + clusters[c].end * 3);
+		}
+		mesh->indices.swap(output);
+	}
+
+	/// <summary>
+	/// Renumbers vertices in order of first use so vertex fetch walks memory linearly. Unreferenced vertices are dropped.
+	/// </summary>
+	/// <param name="mesh">Mesh to reorder in place</param>
+	void optimizeVertexFetch(MeshData* mesh) {
+		const unsigned int UNASSIGNED = 0xFFFFFFFF;
+		std::vector<unsigned int> remap(mesh->vertices.size(), UNASSIGNED);
+		std::vector<Vertex> reordered;
+		reordered.reserve(mesh->vertices.size());
+		for (size_t i = 0; i < mesh->indices.size(); i++)
+		{
+			unsigned int& newIndex = remap[mesh->indices[i]];
+			if (newIndex == UNASSIGNED) {
+				newIndex = (unsigned int)reordered.size();
+				reordered.push_back(mesh->vertices[mesh->indices[i]]);
+			}
+			mesh->indices[i] = newIndex;
+		}
+		mesh->vertices.swap(reordered);
+	}
+
+	/// <summary>
+	/// Runs the full pipeline: weld, vertex cache order, overdraw order, vertex fetch order
+	/// </summary>
+	/// <param name="mesh">Triangle list mesh to optimize in place</param>
+	/// <param name="report">Optional. Receives vertex counts and cache stats before and after</param>
+	void optimizeMesh(MeshData* mesh, MeshOptimizationReport* report) {
+		if (report) {
+			report->verticesBefore = (unsigned int)mesh->vertices.size();
+			report->before = analyzeVertexCache(mesh->indices.data(), mesh->indices.size(), mesh->vertices.size());
+		}
+		weldVertices(mesh);
+		std::vector<unsigned int> clusterStarts;
+		optimizeVertexCache(mesh, &clusterStarts);
+		optimizeOverdraw(mesh, clusterStarts);
+		optimizeVertexFetch(mesh);
+		if (report) {
+			report->verticesAfter = (unsigned int)mesh->vertices.size();
+			report->after = analyzeVertexCache(mesh->indices.data(), mesh->indices.size(), mesh->vertices.size());
+		}
+	}
+
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report) {
+		printf("Optimized %s: vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name,
+			report.verticesBefore, report.verticesAfter,
+			report.before.acmr, report.after.acmr,
+			report.before.atvr, report.after.atvr);
+	}
+}
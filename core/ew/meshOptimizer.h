@@ -0,0 +1,29 @@
+#pragma once
+#include "mesh.h"
+#include <vector>
+
+namespace ew {
+	//Size of the simulated post-transform (FIFO) vertex cache. Matches common desktop GPUs closely enough for ordering.
+	const unsigned int VERTEX_CACHE_SIZE = 16;
+
+	struct VertexCacheStats {
+		float acmr = 0.0f; //Average cache miss ratio: transformed vertices per triangle. 0.5 is ideal for large grids, 3 is worst.
+		float atvr = 0.0f; //Average transform to vertex ratio: transformed vertices per unique vertex. 1 is ideal.
+		unsigned int numTransformed = 0;
+	};
+
+	struct MeshOptimizationReport {
+		unsigned int verticesBefore = 0;
+		unsigned int verticesAfter = 0;
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+
+	VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t numIndices, size_t numVertices, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+	unsigned int weldVertices(MeshData* mesh);
+	void optimizeVertexCache(MeshData* mesh, std::vector<unsigned int>* clusterStarts = nullptr);
+	void optimizeOverdraw(MeshData* mesh, const std::vector<unsigned int>& clusterStarts, float threshold = 1.05f);
+	void optimizeVertexFetch(MeshData* mesh);
+	void optimizeMesh(MeshData* mesh, MeshOptimizationReport* report = nullptr);
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report);
+}
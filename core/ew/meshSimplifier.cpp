@@ -0,0 +1,336 @@
+#include "meshSimplifier.h"
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace ew {
+	static const unsigned int UNASSIGNED = 0xFFFFFFFF;
+
+	//Symmetric 4x4 error quadric (Garland, Heckbert 1997): sum of weight * (dot(n, p) + d)^2 over a set of planes
+	struct Quadric {
+		double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+		double yy = 0.0, yz = 0.0, yw = 0.0;
+		double zz = 0.0, zw = 0.0;
+		double ww = 0.0;
+		double weight = 0.0;
+	};
+
+	static void addPlane(Quadric* q, const glm::dvec3& n, double d, double weight) {
+		q->xx += weight * n.x * n.x;
+		q->xy += weight * n.x * n.y;
+		q->xz += weight * n.x * n.z;
+		q->xw += weight * n.x * d;
+		q->yy += weight * n.y * n.y;
+		q->yz += weight * n.y * n.z;
+		q->yw += weight * n.y * d;
+		q->zz += weight * n.z * n.z;
+		q->zw += weight * n.z * d;
+		q->ww += weight * d * d;
+		q->weight += weight;
+	}
+
+	static void addQuadric(Quadric* q, const Quadric& other) {
+		q->xx += other.xx;
+		q->xy += other.xy;
+		q->xz += other.xz;
+		q->xw += other.xw;
+		q->yy += other.yy;
+		q->yz += other.yz;
+		q->yw += other.yw;
+		q->zz += other.zz;
+		q->zw += other.zw;
+		q->ww += other.ww;
+		q->weight += other.weight;
+	}
+
+	/// <summary>
+	/// Weighted mean squared distance from p to the quadric's planes
+	/// </summary>
+	static double evaluateQuadric(const Quadric& q, const glm::vec3& p) {
+		const double x = p.x, y = p.y, z = p.z;
+		double error = q.xx * x * x + q.yy * y * y + q.zz * z * z
+			+ 2.0 * (q.xy * x * y + q.xz * x * z + q.yz * y * z)
+			+ 2.0 * (q.xw * x + q.yw * y + q.zw * z)
+			+ q.ww;
+		return q.weight > 0.0 ? glm::abs(error) / q.weight : 0.0;
+	}
+
+	struct PositionHasher {
+		size_t operator()(const glm::vec3& p) const {
+			//Adding 0 folds -0.0 into +0.0 so values that compare equal hash equal
+			const float values[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+			unsigned int bits[3];
+			memcpy(bits, values, sizeof(bits));
+			size_t hash = 14695981039346656037ull;
+			for (int i = 0; i < 3; i++)
+			{
+				hash ^= bits[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	static uint64_t getEdgeKey(unsigned int a, unsigned int b) {
+		return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+	}
+
+	/// <summary>
+	/// Checks that moving position `from` onto `to` does not flip any triangle that survives the collapse
+	/// </summary>
+	static bool isCollapseValid(unsigned int from, unsigned int to, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		const std::vector<unsigned int>& positionOf, const std::vector<unsigned int>& triangleOffsets, const std::vector<unsigned int>& triangleList) {
+		for (unsigned int a = triangleOffsets[from]; a < triangleOffsets[from + 1]; a++)
+		{
+			unsigned int triangle = triangleList[a];
+			unsigned int p[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = positionOf[indices[triangle * 3 + k]];
+			}
+			if (p[0] == to || p[1] == to || p[2] == to) {
+				continue; //Removed by the collapse
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				before[k] = vertices[p[k]].pos;
+				after[k] = p[k] == from ? vertices[to].pos : before[k];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Reduces triangle count with quadric error metric edge collapses. Vertices only ever move onto existing vertices,
+	/// so normals, tangents and UVs stay valid without interpolation. Collapses run in independent batches per pass,
+	/// cheapest first, until the target is reached or the next collapse would exceed maxError.
+	/// </summary>
+	/// <param name="mesh">Triangle list mesh to simplify</param>
+	/// <param name="targetIndexCount">Stop once the index count is at or below this</param>
+	/// <param name="result">Receives the simplified mesh, with unused vertices removed. May be the same as mesh</param>
+	/// <param name="maxError">Largest allowed error, in object space units</param>
+	/// <returns>Error of the result, in object space units. Roughly the distance the surface moved</returns>
+	float simplifyMesh(const MeshData& mesh, unsigned int targetIndexCount, MeshData* result, float maxError) {
+		const std::vector<Vertex>& vertices = mesh.vertices;
+		const unsigned int numVertices = (unsigned int)vertices.size();
+
+		//Collapses operate on positions. Vertices that only differ in normal or uv move together.
+		//Each position is represented by the first vertex that has it.
+		std::vector<unsigned int> positionOf(numVertices);
+		{
+			std::unordered_map<glm::vec3, unsigned int, PositionHasher> uniquePositions;
+			uniquePositions.reserve(numVertices);
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				positionOf[i] = uniquePositions.insert(std::make_pair(vertices[i].pos, i)).first->second;
+			}
+		}
+
+		//Drop triangles that are already degenerate in position
+		std::vector<unsigned int> indices;
+		indices.reserve(mesh.indices.size());
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			unsigned int p0 = positionOf[mesh.indices[i + 0]];
+			unsigned int p1 = positionOf[mesh.indices[i + 1]];
+			unsigned int p2 = positionOf[mesh.indices[i + 2]];
+			if (p0 != p1 && p1 != p2 && p2 != p0) {
+				indices.insert(indices.end(), mesh.indices.begin() + i, mesh.indices.begin() + i + 3);
+			}
+		}
+
+		//Area weighted face planes, plus perpendicular planes along open edges so borders do not shrink
+		std::vector<Quadric> quadrics(numVertices);
+		std::unordered_map<uint64_t, unsigned int> edgeCounts;
+		edgeCounts.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			size_t next = i % 3 == 2 ? i - 2 : i + 1;
+			edgeCounts[getEdgeKey(positionOf[indices[i]], positionOf[indices[next]])]++;
+		}
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			unsigned int p[3];
+			glm::dvec3 pos[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = positionOf[indices[t * 3 + k]];
+				pos[k] = glm::dvec3(vertices[p[k]].pos);
+			}
+			glm::dvec3 normal = glm::cross(pos[1] - pos[0], pos[2] - pos[0]);
+			double normalLength = glm::length(normal);
+			if (normalLength <= 0.0) {
+				continue;
+			}
+			normal /= normalLength;
+			double d = -glm::dot(normal, pos[0]);
+			for (int k = 0; k < 3; k++)
+			{
+				addPlane(&quadrics[p[k]], normal, d, normalLength * 0.5);
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				int k1 = (k + 1) % 3;
+				if (edgeCounts[getEdgeKey(p[k], p[k1])] != 1) {
+					continue;
+				}
+				glm::dvec3 edge = pos[k1] - pos[k];
+				double edgeLengthSq = glm::dot(edge, edge);
+				glm::dvec3 borderNormal = glm::cross(edge, normal);
+				double borderNormalLength = glm::length(borderNormal);
+				if (borderNormalLength <= 0.0) {
+					continue;
+				}
+				borderNormal /= borderNormalLength;
+				double borderD = -glm::dot(borderNormal, pos[k]);
+				addPlane(&quadrics[p[k]], borderNormal, borderD, edgeLengthSq * SIMPLIFY_BORDER_WEIGHT);
+				addPlane(&quadrics[p[k1]], borderNormal, borderD, edgeLengthSq * SIMPLIFY_BORDER_WEIGHT);
+			}
+		}
+
+		struct Collapse {
+			unsigned int from, to;
+			double error;
+		};
+		std::vector<Collapse> collapses;
+		std::vector<unsigned int> triangleOffsets;
+		std::vector<unsigned int> triangleList;
+		std::vector<unsigned int> positionRemap(numVertices);
+		std::vector<unsigned int> vertexRemap(numVertices);
+		std::vector<bool> locked(numVertices);
+		const double maxErrorSq = (double)maxError * maxError;
+		double resultErrorSq = 0.0;
+		while (indices.size() > targetIndexCount) {
+			//Position -> triangle adjacency in CSR form
+			triangleOffsets.assign(numVertices + 1, 0);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				triangleOffsets[positionOf[indices[i]] + 1]++;
+			}
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				triangleOffsets[i + 1] += triangleOffsets[i];
+			}
+			triangleList.resize(indices.size());
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				triangleList[fill[positionOf[indices[i]]]++] = (unsigned int)(i / 3);
+			}
+
+			//Cheapest direction of every edge. Interior edges show up twice, the duplicate fails the lock test below.
+			collapses.clear();
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				size_t next = i % 3 == 2 ? i - 2 : i + 1;
+				unsigned int a = positionOf[indices[i]];
+				unsigned int b = positionOf[indices[next]];
+				Quadric q = quadrics[a];
+				addQuadric(&q, quadrics[b]);
+				double errorAB = evaluateQuadric(q, vertices[b].pos);
+				double errorBA = evaluateQuadric(q, vertices[a].pos);
+				collapses.push_back(errorAB <= errorBA ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA });
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.error < b.error;
+			});
+
+			//Apply collapses whose neighborhoods do not overlap, so every validity check sees final positions
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				positionRemap[i] = i;
+			}
+			vertexRemap.assign(numVertices, UNASSIGNED);
+			locked.assign(numVertices, false);
+			const size_t trianglesToRemove = std::max<size_t>((indices.size() - targetIndexCount) / 3, 1);
+			size_t trianglesRemoved = 0;
+			for (size_t c = 0; c < collapses.size() && trianglesRemoved < trianglesToRemove; c++)
+			{
+				const Collapse& collapse = collapses[c];
+				if (collapse.error > maxErrorSq) {
+					break;
+				}
+				if (locked[collapse.from] || locked[collapse.to]) {
+					continue;
+				}
+				if (!isCollapseValid(collapse.from, collapse.to, vertices, indices, positionOf, triangleOffsets, triangleList)) {
+					continue;
+				}
+				for (unsigned int a = triangleOffsets[collapse.from]; a < triangleOffsets[collapse.from + 1]; a++)
+				{
+					const unsigned int* triangle = &indices[triangleList[a] * 3];
+					int fromCorner = -1;
+					int toCorner = -1;
+					for (int k = 0; k < 3; k++)
+					{
+						locked[positionOf[triangle[k]]] = true;
+						if (positionOf[triangle[k]] == collapse.from) {
+							fromCorner = k;
+						}
+						else if (positionOf[triangle[k]] == collapse.to) {
+							toCorner = k;
+						}
+					}
+					//Attributes follow the edge: a vertex moves onto the vertex it shares a triangle with at the target
+					if (toCorner >= 0) {
+						vertexRemap[triangle[fromCorner]] = triangle[toCorner];
+						trianglesRemoved++;
+					}
+				}
+				positionRemap[collapse.from] = collapse.to;
+				addQuadric(&quadrics[collapse.to], quadrics[collapse.from]);
+				resultErrorSq = std::max(resultErrorSq, collapse.error);
+			}
+			if (trianglesRemoved == 0) {
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t t = 0; t < indices.size() / 3; t++)
+			{
+				unsigned int v[3];
+				for (int k = 0; k < 3; k++)
+				{
+					v[k] = indices[t * 3 + k];
+					if (vertexRemap[v[k]] != UNASSIGNED) {
+						v[k] = vertexRemap[v[k]];
+					}
+					else if (positionRemap[positionOf[v[k]]] != positionOf[v[k]]) {
+						v[k] = positionRemap[positionOf[v[k]]];
+					}
+				}
+				unsigned int p0 = positionOf[v[0]], p1 = positionOf[v[1]], p2 = positionOf[v[2]];
+				if (p0 != p1 && p1 != p2 && p2 != p0) {
+					indices[write++] = v[0];
+					indices[write++] = v[1];
+					indices[write++] = v[2];
+				}
+			}
+			indices.resize(write);
+		}
+
+		//Keep only referenced vertices, in first use order
+		std::vector<Vertex> simplifiedVertices;
+		std::vector<unsigned int> newIndex(numVertices, UNASSIGNED);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			unsigned int& index = newIndex[indices[i]];
+			if (index == UNASSIGNED) {
+				index = (unsigned int)simplifiedVertices.size();
+				simplifiedVertices.push_back(vertices[indices[i]]);
+			}
+			indices[i] = index;
+		}
+		result->vertices.swap(simplifiedVertices);
+		result->indices.swap(indices);
+		return (float)glm::sqrt(resultErrorSq);
+	}
+}
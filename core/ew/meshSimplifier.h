@@ -0,0 +1,10 @@
+#pragma once
+#include "mesh.h"
+#include <float.h>
+
+namespace ew {
+	//Weight of the planes that hold open borders in place, relative to face planes of the same size
+	const float SIMPLIFY_BORDER_WEIGHT = 10.0f;
+
+	float simplifyMesh(const MeshData& mesh, unsigned int targetIndexCount, MeshData* result, float maxError = FLT_MAX);
+}
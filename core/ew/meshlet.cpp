@@ -0,0 +1,221 @@
+#include "meshlet.h"
+#include <algorithm>
+
+namespace ew {
+	static const unsigned int UNASSIGNED = 0xFFFFFFFF;
+
+	/// <summary>
+	/// Fills in AABB, bounding sphere and normal cone from a meshlet's triangles
+	/// </summary>
+	static void computeMeshletBounds(const std::vector<Vertex>& vertices, const unsigned int* indices, Meshlet* meshlet) {
+		const unsigned int numIndices = meshlet->numTriangles * 3;
+		meshlet->boundsMin = meshlet->boundsMax = vertices[indices[0]].pos;
+		for (unsigned int i = 1; i < numIndices; i++)
+		{
+			meshlet->boundsMin = glm::min(meshlet->boundsMin, vertices[indices[i]].pos);
+			meshlet->boundsMax = glm::max(meshlet->boundsMax, vertices[indices[i]].pos);
+		}
+		meshlet->center = (meshlet->boundsMin + meshlet->boundsMax) * 0.5f;
+		meshlet->radius = 0.0f;
+		for (unsigned int i = 0; i < numIndices; i++)
+		{
+			meshlet->radius = glm::max(meshlet->radius, glm::length(vertices[indices[i]].pos - meshlet->center));
+		}
+
+		//Cone axis is the mean face normal. Its cutoff is the sine of the widest angle from the axis to any face normal.
+		glm::vec3 normalSum = glm::vec3(0.0f);
+		for (unsigned int t = 0; t < meshlet->numTriangles; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+			glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]].pos - p0, vertices[indices[t * 3 + 2]].pos - p0);
+			float normalLength = glm::length(normal);
+			if (normalLength > 0.0f) {
+				normalSum += normal / normalLength;
+			}
+		}
+		meshlet->coneAxis = glm::vec3(0.0f);
+		meshlet->coneCutoff = 1.0f;
+		float axisLength = glm::length(normalSum);
+		if (axisLength <= 0.0f) {
+			return;
+		}
+		glm::vec3 axis = normalSum / axisLength;
+		float minDot = 1.0f;
+		for (unsigned int t = 0; t < meshlet->numTriangles; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+			glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]].pos - p0, vertices[indices[t * 3 + 2]].pos - p0);
+			float normalLength = glm::length(normal);
+			if (normalLength > 0.0f) {
+				minDot = glm::min(minDot, glm::dot(normal / normalLength, axis));
+			}
+		}
+		//Faces spread over a hemisphere or more can never all face away at once
+		if (minDot <= 0.0f) {
+			return;
+		}
+		meshlet->coneAxis = axis;
+		meshlet->coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+	}
+
+	/// <summary>
+	/// Splits a mesh into clusters of at most maxVertices unique vertices and maxTriangles triangles.
+	/// Each cluster grows from a seed triangle by repeatedly adding the adjacent triangle that brings in the fewest new vertices.
+	/// Indices are reordered so every meshlet is a contiguous range. Vertices are not touched.
+	/// Run after ew::optimizeMesh; seeds are taken in index order, so a cache friendly order gives compact clusters.
+	/// </summary>
+	/// <param name="mesh">Triangle list mesh whose indices are reordered in place</param>
+	/// <param name="meshlets">Receives the clusters in index buffer order</param>
+	/// <param name="maxVertices">Vertex limit per cluster. At least 3</param>
+	/// <param name="maxTriangles">Triangle limit per cluster</param>
+	void buildMeshlets(MeshData* mesh, std::vector<Meshlet>* meshlets, unsigned int maxVertices, unsigned int maxTriangles) {
+		meshlets->clear();
+		const std::vector<unsigned int>& indices = mesh->indices;
+		const size_t numVertices = mesh->vertices.size();
+		const size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0) {
+			return;
+		}
+
+		//Vertex -> triangle adjacency in CSR form
+		std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			adjacencyOffsets[indices[i] + 1]++;
+		}
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		std::vector<unsigned int> adjacency(numTriangles * 3);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<unsigned int> meshletOf(numVertices, UNASSIGNED); //Last meshlet to reference each vertex
+		std::vector<unsigned int> meshletVertices;
+		meshletVertices.reserve(maxVertices);
+		std::vector<unsigned int> output;
+		output.reserve(numTriangles * 3);
+		size_t cursor = 0; //Next seed candidate in input order
+		while (true) {
+			while (cursor < numTriangles && emitted[cursor]) {
+				cursor++;
+			}
+			if (cursor == numTriangles) {
+				break;
+			}
+			const unsigned int meshletIndex = (unsigned int)meshlets->size();
+			Meshlet meshlet = {};
+			meshlet.firstIndex = (unsigned int)output.size();
+			meshletVertices.clear();
+			size_t triangle = cursor;
+			while (true) {
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[triangle * 3 + k];
+					if (meshletOf[v] != meshletIndex) {
+						meshletOf[v] = meshletIndex;
+						meshletVertices.push_back(v);
+					}
+					output.push_back(v);
+				}
+				emitted[triangle] = true;
+				meshlet.numTriangles++;
+				if (meshlet.numTriangles >= maxTriangles) {
+					break;
+				}
+
+				//Neighbor that adds the fewest new vertices and still fits. Shared edges (one new vertex) keep clusters connected.
+				size_t bestTriangle = numTriangles;
+				unsigned int bestNewVertices = 4;
+				for (size_t i = 0; i < meshletVertices.size() && bestNewVertices > 0; i++)
+				{
+					unsigned int v = meshletVertices[i];
+					for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+					{
+						unsigned int candidate = adjacency[a];
+						if (emitted[candidate]) {
+							continue;
+						}
+						unsigned int newVertices = 0;
+						for (int k = 0; k < 3; k++)
+						{
+							newVertices += meshletOf[indices[candidate * 3 + k]] != meshletIndex ? 1 : 0;
+						}
+						if (meshletVertices.size() + newVertices > maxVertices || newVertices >= bestNewVertices) {
+							continue;
+						}
+						bestTriangle = candidate;
+						bestNewVertices = newVertices;
+						if (newVertices == 0) {
+							break;
+						}
+					}
+				}
+				if (bestTriangle == numTriangles) {
+					break;
+				}
+				triangle = bestTriangle;
+			}
+			meshlet.numVertices = (unsigned int)meshletVertices.size();
+			computeMeshletBounds(mesh->vertices, &output[meshlet.firstIndex], &meshlet);
+			meshlets->push_back(meshlet);
+		}
+		mesh->indices.swap(output);
+	}
+
+	/// <summary>
+	/// Moves a camera's frustum planes, eye and view direction into the object space of modelMatrix
+	/// </summary>
+	/// <param name="camera">Camera to cull against</param>
+	/// <param name="modelMatrix">Object to world transform of the mesh being drawn</param>
+	/// <param name="cullFrontFaces">Cull clusters that face the camera instead of away from it</param>
+	MeshletCullView createMeshletCullView(const ew::Camera& camera, const glm::mat4& modelMatrix, bool cullFrontFaces) {
+		MeshletCullView view;
+		//Gribb/Hartmann plane extraction from the object space clip matrix
+		glm::mat4 clip = camera.projectionMatrix() * camera.viewMatrix() * modelMatrix;
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; r++)
+		{
+			rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			view.frustumPlanes[i * 2 + 0] = rows[3] + rows[i];
+			view.frustumPlanes[i * 2 + 1] = rows[3] - rows[i];
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			view.frustumPlanes[i] /= glm::length(glm::vec3(view.frustumPlanes[i]));
+		}
+		glm::mat4 worldToObject = glm::inverse(modelMatrix);
+		view.position = glm::vec3(worldToObject * glm::vec4(camera.position, 1.0f));
+		view.direction = glm::normalize(glm::vec3(worldToObject * glm::vec4(camera.target - camera.position, 0.0f)));
+		view.orthographic = camera.orthographic;
+		view.cullFrontFaces = cullFrontFaces;
+		return view;
+	}
+
+	/// <summary>
+	/// Frustum test against the bounding sphere, then a backface test against the normal cone.
+	/// The perspective cone test uses the sphere instead of an apex, so it also works with the cone flipped for front face culling.
+	/// </summary>
+	bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullView& view) {
+		for (int i = 0; i < 6; i++)
+		{
+			if (glm::dot(glm::vec3(view.frustumPlanes[i]), meshlet.center) + view.frustumPlanes[i].w < -meshlet.radius) {
+				return false;
+			}
+		}
+		glm::vec3 axis = view.cullFrontFaces ? -meshlet.coneAxis : meshlet.coneAxis;
+		if (view.orthographic) {
+			return glm::dot(view.direction, axis) < meshlet.coneCutoff;
+		}
+		glm::vec3 toCenter = meshlet.center - view.position;
+		return glm::dot(toCenter, axis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "mesh.h"
+#include "camera.h"
+#include <vector>
+
+namespace ew {
+	const unsigned int MESHLET_MAX_VERTICES = 64;
+	const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+	void buildMeshlets(MeshData* mesh, std::vector<Meshlet>* meshlets, unsigned int maxVertices = MESHLET_MAX_VERTICES, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES);
+	MeshletCullView createMeshletCullView(const ew::Camera& camera, const glm::mat4& modelMatrix, bool cullFrontFaces = false);
+	bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullView& view);
+}
@@ -3,44 +3,369 @@
 */
 
 #include "model.h"
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include "vertexPacking.h"
+#include "threadPool.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <stdio.h>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	ew::MeshData processAiMesh(const aiMesh* aiMesh);
+	void processAiScene(const aiScene* aiScene, ew::ThreadPool& threadPool, std::vector<ew::MeshData>* meshDatas);
+	void buildLODs(std::vector<ew::MeshData>* meshDatas, std::vector<ew::MeshLODInfo>* lodInfos, const ModelLoadOptions& options, ew::ThreadPool& threadPool);
 
-	Model::Model(const std::string& filePath)
+	//Vertex and index arrays for one mesh, either in the mapped cache or in converted MeshData
+	struct MeshSource {
+		const void* vertices; //In ModelLoadOptions::vertexFormat
+		unsigned int numVertices;
+		const void* indices;
+		unsigned int numIndices;
+		ew::IndexType indexType;
+		ew::MeshLODInfo lod;
+		const ew::Meshlet* meshlets;
+		unsigned int numMeshlets;
+	};
+
+	Model::Model(const std::string& filePath, const ModelLoadOptions& options)
 	{
-		Assimp::Importer importer;
-		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
-		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+		const unsigned int importFlags = aiProcess_Triangulate;
+		const unsigned int processFlags = ew::getMeshProcessFlags(options.optimize, options.buildMeshlets, options.numLODs, options.lodReduction);
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		//Warm start: upload straight out of the mapped cache file, already packed
+		ew::MeshCacheFile cache;
+		std::vector<ew::MeshData> meshDatas;
+		std::vector<ew::PackedVertexData> packedVertices;
+		std::vector<MeshSource> sources;
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		glm::mat4 dequantize = glm::mat4(1.0f);
+		bool cacheHit = options.useCache && ew::openMeshCache(filePath, importFlags, processFlags, options.vertexFormat, &cache);
+		if (cacheHit) {
+			cache.getBounds(&boundsMin, &boundsMax);
+			dequantize = cache.getDequantizationMatrix();
+			sources.resize(cache.getNumMeshes());
+			for (unsigned int i = 0; i < cache.getNumMeshes(); i++)
+			{
+				const ew::MeshCacheEntry& entry = cache.getEntry(i);
+				sources[i] = { cache.getVertexData(i), entry.numVertices, cache.getIndices(i), entry.numIndices, cache.getIndexType(i), cache.getLODInfo(i), cache.getMeshlets(i), entry.numMeshlets };
+			}
+		}
+		else {
+			Assimp::Importer importer;
+			const aiScene* aiScene = importer.ReadFile(filePath, importFlags);
+			if (aiScene == NULL) {
+				printf("Failed to load model %s: %s\n", filePath.c_str(), importer.GetErrorString());
+				return;
+			}
+			//Convert on workers, then upload everything from this (GL) thread
+			ew::ThreadPool& threadPool = options.threadPool ? *options.threadPool : ew::getWorkerPool();
+			processAiScene(aiScene, threadPool, &meshDatas);
+			if (options.optimize) {
+				std::vector<ew::MeshOptimizationReport> reports(meshDatas.size());
+				threadPool.parallelFor(meshDatas.size(), [&](size_t i) {
+					ew::optimizeMesh(&meshDatas[i], &reports[i]);
+				});
+				for (size_t i = 0; i < reports.size(); i++)
+				{
+					std::string meshName = filePath + "[" + std::to_string(i) + "]";
+					ew::printMeshOptimizationReport(meshName.c_str(), reports[i]);
+				}
+			}
+			std::vector<ew::MeshLODInfo> lodInfos(meshDatas.size());
+			if (options.numLODs > 1) {
+				buildLODs(&meshDatas, &lodInfos, options, threadPool);
+			}
+			//Reorders indices, so it runs last and the cache stores the meshlet order
+			std::vector<std::vector<ew::Meshlet>> meshlets(meshDatas.size());
+			if (options.buildMeshlets) {
+				threadPool.parallelFor(meshDatas.size(), [&](size_t i) {
+					ew::buildMeshlets(&meshDatas[i], &meshlets[i]);
+				});
+			}
+			//All meshes are quantized against the model's bounds so they share one dequantization matrix
+			bool hasBounds = false;
+			for (size_t i = 0; i < meshDatas.size(); i++)
+			{
+				for (size_t j = 0; j < meshDatas[i].vertices.size(); j++)
+				{
+					const glm::vec3& pos = meshDatas[i].vertices[j].pos;
+					boundsMin = hasBounds ? glm::min(boundsMin, pos) : pos;
+					boundsMax = hasBounds ? glm::max(boundsMax, pos) : pos;
+					hasBounds = true;
+				}
+			}
+			//Packed once here; the cache stores the result so warm loads never repack
+			if (options.vertexFormat != ew::VertexFormat::FULL) {
+				packedVertices.resize(meshDatas.size());
+				std::vector<ew::VertexPackingReport> reports(meshDatas.size());
+				threadPool.parallelFor(meshDatas.size(), [&](size_t i) {
+					ew::packVertices(meshDatas[i].vertices.data(), (unsigned int)meshDatas[i].vertices.size(), options.vertexFormat, boundsMin, boundsMax, &packedVertices[i], &reports[i]);
+				});
+				for (size_t i = 0; i < reports.size(); i++)
+				{
+					std::string meshName = filePath + "[" + std::to_string(i) + "]";
+					ew::printVertexPackingReport(meshName.c_str(), reports[i]);
+				}
+				if (!packedVertices.empty()) {
+					dequantize = packedVertices[0].dequantizeMatrix;
+				}
+			}
+			if (options.useCache) {
+				ew::writeMeshCache(filePath, importFlags, processFlags, meshDatas, &lodInfos, &meshlets, &packedVertices);
+			}
+			sources.resize(meshDatas.size());
+			for (size_t i = 0; i < meshDatas.size(); i++)
+			{
+				const ew::MeshData& meshData = meshDatas[i];
+				const void* vertices = packedVertices.empty() ? (const void*)meshData.vertices.data() : (const void*)packedVertices[i].bytes.data();
+				sources[i] = { vertices, (unsigned int)meshData.vertices.size(), meshData.indices.data(), (unsigned int)meshData.indices.size(), ew::IndexType::UINT32, lodInfos[i], meshlets[i].data(), (unsigned int)meshlets[i].size() };
+			}
+		}
+
+		m_boundsCenter = (boundsMin + boundsMax) * 0.5f;
+		m_boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+		m_dequantize = dequantize;
+
+		m_meshes.resize(sources.size());
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const MeshSource& source = sources[i];
+			m_meshes[i].setMeshlets(source.meshlets, source.numMeshlets);
+			//Freshly converted meshes have 32 bit indices; the cache already stores them narrowed
+			if (source.indexType == ew::IndexType::UINT32 && ew::getIndexType(source.numVertices) == ew::IndexType::UINT16) {
+				const unsigned int* indices = (const unsigned int*)source.indices;
+				std::vector<uint16_t> shortIndices(indices, indices + source.numIndices);
+				m_meshes[i].load(options.vertexFormat, source.vertices, source.numVertices, dequantize, shortIndices.data(), source.numIndices, ew::IndexType::UINT16);
+			}
+			else {
+				m_meshes[i].load(options.vertexFormat, source.vertices, source.numVertices, dequantize, source.indices, source.numIndices, source.indexType);
+			}
+		}
+
+		//Sources are stored level-major, so each level is one contiguous run of meshes
+		m_lods.clear();
+		for (size_t i = 0; i < sources.size(); i++)
 		{
-			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			unsigned int level = sources[i].lod.level;
+			if (level >= m_lods.size()) {
+				m_lods.resize(level + 1);
+				m_lods[level].firstMesh = i;
+			}
+			m_lods[level].numMeshes++;
+			m_lods[level].error = glm::max(m_lods[level].error, sources[i].lod.error);
+			m_lods[level].numTriangles += sources[i].numIndices / 3;
 		}
+		for (size_t i = 1; i < m_lods.size(); i++)
+		{
+			printf("  LOD %zu: %u triangles, error %.5f\n", i, m_lods[i].numTriangles, m_lods[i].error);
+		}
+
+		std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - startTime;
+		printf("Loaded model %s in %.2fms (%s)\n", filePath.c_str(), loadTime.count(), cacheHit ? "cache hit" : "cache miss");
 	}
 
 	void Model::draw()
+	{
+		draw(0);
+	}
+
+	/// <summary>
+	/// Deletes the GL buffers of every mesh and level
+	/// </summary>
+	void Model::release()
 	{
 		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].release();
+		}
+		m_meshes.clear();
+		m_lods.clear();
+	}
+
+	/// <summary>
+	/// Draws one detail level. Levels past the coarsest draw the coarsest.
+	/// </summary>
+	void Model::draw(unsigned int lod)
+	{
+		if (m_lods.empty()) {
+			return;
+		}
+		const ModelLOD& level = m_lods[glm::min(lod, (unsigned int)m_lods.size() - 1)];
+		for (size_t i = level.firstMesh; i < level.firstMesh + level.numMeshes; i++)
 		{
 			m_meshes[i].draw();
 		}
 	}
 
+	/// <summary>
+	/// Draws the coarsest level whose error stays under maxPixelError on screen, culling meshlets against the camera
+	/// </summary>
+	/// <param name="camera">Camera the model is viewed through</param>
+	/// <param name="modelMatrix">Model's transform, without the dequantization matrix</param>
+	/// <param name="screenHeight">Viewport height in pixels</param>
+	/// <param name="maxPixelError">Largest acceptable error in pixels</param>
+	void Model::draw(const ew::Camera& camera, const glm::mat4& modelMatrix, float screenHeight, float maxPixelError)
+	{
+		draw(ew::createMeshletCullView(camera, modelMatrix), selectLOD(camera, modelMatrix, screenHeight, maxPixelError));
+	}
+
+	/// <summary>
+	/// Draws one detail level, skipping meshlets that are outside the view or face away from it.
+	/// Meshes loaded without meshlets draw in full.
+	/// </summary>
+	/// <param name="view">From ew::createMeshletCullView with this model's transform</param>
+	/// <param name="lod">Detail level</param>
+	void Model::draw(const MeshletCullView& view, unsigned int lod)
+	{
+		if (m_lods.empty()) {
+			return;
+		}
+		const ModelLOD& level = m_lods[glm::min(lod, (unsigned int)m_lods.size() - 1)];
+		for (size_t i = level.firstMesh; i < level.firstMesh + level.numMeshes; i++)
+		{
+			m_meshes[i].draw(view);
+		}
+	}
+
+	/// <summary>
+	/// Projects each level's error at the nearest point of the model's bounding sphere and picks the coarsest level under maxPixelError
+	/// </summary>
+	unsigned int Model::selectLOD(const ew::Camera& camera, const glm::mat4& modelMatrix, float screenHeight, float maxPixelError) const
+	{
+		if (m_lods.size() <= 1) {
+			return 0;
+		}
+		//Largest axis scale, so error and radius stay conservative under non-uniform scale
+		float scale = glm::sqrt(glm::max(glm::dot(modelMatrix[0], modelMatrix[0]), glm::max(glm::dot(modelMatrix[1], modelMatrix[1]), glm::dot(modelMatrix[2], modelMatrix[2]))));
+		float pixelsPerUnit;
+		if (camera.orthographic) {
+			pixelsPerUnit = screenHeight / camera.orthoHeight;
+		}
+		else {
+			glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(m_boundsCenter, 1.0f));
+			float distance = glm::max(glm::length(center - camera.position) - m_boundsRadius * scale, camera.nearPlane);
+			pixelsPerUnit = screenHeight / (2.0f * distance * glm::tan(glm::radians(camera.fov) * 0.5f));
+		}
+		unsigned int lod = 0;
+		for (unsigned int i = 1; i < m_lods.size(); i++)
+		{
+			if (m_lods[i].error * scale * pixelsPerUnit > maxPixelError) {
+				break;
+			}
+			lod = i;
+		}
+		return lod;
+	}
+
+	/// <summary>
+	/// Imports a model once and times aiMesh -> MeshData conversion with 1..maxThreads threads. Results are printed.
+	/// Nothing is uploaded, so this does not need a GL context.
+	/// </summary>
+	/// <param name="filePath">Model to import</param>
+	/// <param name="maxThreads">Highest thread count to test, including the calling thread</param>
+	/// <param name="iterations">Runs per thread count. The fastest run is reported</param>
+	void benchmarkModelImport(const std::string& filePath, unsigned int maxThreads, int iterations) {
+		Assimp::Importer importer;
+		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+		if (aiScene == NULL) {
+			printf("Failed to load model %s: %s\n", filePath.c_str(), importer.GetErrorString());
+			return;
+		}
+		size_t numVertices = 0;
+		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+		{
+			numVertices += aiScene->mMeshes[i]->mNumVertices;
+		}
+		printf("Import benchmark %s: %u meshes, %zu vertices\n", filePath.c_str(), aiScene->mNumMeshes, numVertices);
+		double singleThreadTime = 0.0;
+		for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads++)
+		{
+			//parallelFor also runs jobs on the calling thread, so the pool gets one fewer worker
+			ew::ThreadPool threadPool(numThreads > 1 ? numThreads - 1 : 1);
+			double bestTime = 0.0;
+			for (int i = 0; i < iterations; i++)
+			{
+				std::vector<ew::MeshData> meshDatas;
+				auto startTime = std::chrono::high_resolution_clock::now();
+				if (numThreads == 1) {
+					meshDatas.resize(aiScene->mNumMeshes);
+					for (size_t j = 0; j < aiScene->mNumMeshes; j++)
+					{
+						meshDatas[j] = processAiMesh(aiScene->mMeshes[j]);
+					}
+				}
+				else {
+					processAiScene(aiScene, threadPool, &meshDatas);
+				}
+				std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+				if (i == 0 || time.count() < bestTime) {
+					bestTime = time.count();
+				}
+			}
+			if (numThreads == 1) {
+				singleThreadTime = bestTime;
+			}
+			printf("  %2u threads: %8.3fms (%.2fx)\n", numThreads, bestTime, bestTime > 0.0 ? singleThreadTime / bestTime : 0.0);
+		}
+	}
+
 	glm::vec3 convertAIVec3(const aiVector3D& v) {
 		return glm::vec3(v.x, v.y, v.z);
 	}
 
 	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+
+	/// <summary>
+	/// Converts every mesh in a scene in parallel. Safe to run off the GL thread.
+	/// </summary>
+	void processAiScene(const aiScene* aiScene, ew::ThreadPool& threadPool, std::vector<ew::MeshData>* meshDatas) {
+		meshDatas->resize(aiScene->mNumMeshes);
+		threadPool.parallelFor(aiScene->mNumMeshes, [&](size_t i) {
+			(*meshDatas)[i] = processAiMesh(aiScene->mMeshes[i]);
+		});
+	}
+
+	/// <summary>
+	/// Appends options.numLODs - 1 simplified levels after the full detail meshes. Each level simplifies the one before it.
+	/// </summary>
+	/// <param name="meshDatas">Full detail meshes in scene order. Grows to numLODs x meshes, level-major</param>
+	/// <param name="lodInfos">Receives the level and accumulated error of every mesh</param>
+	void buildLODs(std::vector<ew::MeshData>* meshDatas, std::vector<ew::MeshLODInfo>* lodInfos, const ModelLoadOptions& options, ew::ThreadPool& threadPool) {
+		const size_t numMeshes = meshDatas->size();
+		const unsigned int numLODs = options.numLODs;
+		meshDatas->resize(numMeshes * numLODs);
+		lodInfos->assign(numMeshes * numLODs, ew::MeshLODInfo());
+		threadPool.parallelFor(numMeshes, [&](size_t i) {
+			for (unsigned int level = 1; level < numLODs; level++)
+			{
+				const ew::MeshData& previous = (*meshDatas)[(level - 1) * numMeshes + i];
+				ew::MeshData& lod = (*meshDatas)[level * numMeshes + i];
+				unsigned int targetIndexCount = (unsigned int)(previous.indices.size() / 3 * options.lodReduction) * 3;
+				float error = ew::simplifyMesh(previous, targetIndexCount, &lod);
+				if (options.optimize) {
+					ew::optimizeMesh(&lod);
+				}
+				(*lodInfos)[level * numMeshes + i].level = level;
+				(*lodInfos)[level * numMeshes + i].error = (*lodInfos)[(level - 1) * numMeshes + i].error + error;
+			}
+		});
+	}
+
+	ew::MeshData processAiMesh(const aiMesh* aiMesh) {
 		ew::MeshData meshData;
+		meshData.vertices.resize(aiMesh->mNumVertices);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
-			ew::Vertex vertex;
+			ew::Vertex& vertex = meshData.vertices[i];
 			vertex.pos = convertAIVec3(aiMesh->mVertices[i]);
 			if (aiMesh->HasNormals()) {
 				vertex.normal = convertAIVec3(aiMesh->mNormals[i]);
@@ -51,17 +376,23 @@ namespace ew {
 			if (aiMesh->HasTextureCoords(0)) {
 				vertex.uv = glm::vec2(convertAIVec3(aiMesh->mTextureCoords[0][i]));
 			}
-			meshData.vertices.push_back(vertex);
 		}
 		//Convert faces to indices
+		size_t numIndices = 0;
+		for (size_t i = 0; i < aiMesh->mNumFaces; i++)
+		{
+			numIndices += aiMesh->mFaces[i].mNumIndices;
+		}
+		meshData.indices.resize(numIndices);
+		unsigned int* index = meshData.indices.data();
 		for (size_t i = 0; i < aiMesh->mNumFaces; i++)
 		{
 			for (size_t j = 0; j < aiMesh->mFaces[i].mNumIndices; j++)
 			{
-				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
+				*index++ = aiMesh->mFaces[i].mIndices[j];
 			}
 		}
-		return ew::Mesh(meshData);
+		return meshData;
 	}
 
 }
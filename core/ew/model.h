@@ -5,14 +5,51 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "camera.h"
 #include <vector>
 
 namespace ew {
+	class ThreadPool;
+
+	struct ModelLoadOptions {
+		ThreadPool* threadPool = nullptr; //Pool used to convert meshes. Null uses ew::getWorkerPool()
+		bool useCache = true; //Read/write <filePath>.ewmesh
+		bool optimize = false; //Run ew::optimizeMesh on each mesh after import. Cached, so only paid on a cache miss
+		VertexFormat vertexFormat = VertexFormat::FULL; //Packed formats are converted on a cache miss, print their quantization error, and are cached packed
+		unsigned int numLODs = 1; //Detail levels including the original. Extra levels are built by ew::simplifyMesh and cached
+		float lodReduction = 0.5f; //Triangle ratio between consecutive levels
+		bool buildMeshlets = false; //Split every mesh (and LOD) into culling clusters with ew::buildMeshlets. Cached
+	};
+
+	//One detail level: a run of m_meshes with one entry per source mesh
+	struct ModelLOD {
+		size_t firstMesh = 0;
+		size_t numMeshes = 0;
+		float error = 0.0f; //Object space error of this level
+		unsigned int numTriangles = 0;
+	};
+
 	class Model {
 	public:
-		Model(const std::string& filePath);
+		Model(const std::string& filePath, const ModelLoadOptions& options = ModelLoadOptions());
 		void draw();
+		void draw(unsigned int lod);
+		void draw(const MeshletCullView& view, unsigned int lod = 0);
+		void draw(const ew::Camera& camera, const glm::mat4& modelMatrix, float screenHeight, float maxPixelError = 1.0f);
+		unsigned int selectLOD(const ew::Camera& camera, const glm::mat4& modelMatrix, float screenHeight, float maxPixelError = 1.0f)const;
+		inline unsigned int getNumLODs()const { return (unsigned int)m_lods.size(); }
+		inline const ModelLOD& getLOD(unsigned int lod)const { return m_lods[lod]; }
+		inline const ew::Mesh& getMesh(size_t index)const { return m_meshes[index]; } //Index from ModelLOD::firstMesh
+		void release();
+		//Multiply into the model matrix when loaded as VertexFormat::PACKED_QUANTIZED. Identity otherwise.
+		inline const glm::mat4& getDequantizationMatrix()const { return m_dequantize; }
 	private:
-		std::vector<ew::Mesh> m_meshes;
+		std::vector<ew::Mesh> m_meshes; //All levels, finest first
+		std::vector<ModelLOD> m_lods;
+		glm::mat4 m_dequantize = glm::mat4(1.0f);
+		glm::vec3 m_boundsCenter = glm::vec3(0.0f);
+		float m_boundsRadius = 0.0f;
 	};
-}
\ No newline at end of file
+
+	void benchmarkModelImport(const std::string& filePath, unsigned int maxThreads, int iterations = 5);
+}
@@ -0,0 +1,144 @@
+#include "programCache.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace ew {
+	static std::string s_programCacheDirectory = "shadercache";
+
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//Hashes the string and its terminator, so adjacent strings cannot run together
+	static uint64_t hashCString(const char* str, uint64_t hash) {
+		return hashBytes(str != NULL ? str : "", (str != NULL ? strlen(str) : 0) + 1, hash);
+	}
+
+	void setProgramCacheDirectory(const std::string& directory) {
+		s_programCacheDirectory = directory;
+	}
+
+	const std::string& getProgramCacheDirectory() {
+		return s_programCacheDirectory;
+	}
+
+	/// <summary>
+	/// Hash of the exact source strings handed to GL plus the driver identity.
+	/// Binaries are only valid for the driver that produced them, so an update or a different GPU is a miss.
+	/// </summary>
+	/// <param name="sources">Final GLSL for each stage, in stage order</param>
+	uint64_t getProgramCacheKey(const char* const* sources, unsigned int numSources) {
+		uint64_t hash = 14695981039346656037ull;
+		hash = hashCString((const char*)glGetString(GL_VENDOR), hash);
+		hash = hashCString((const char*)glGetString(GL_RENDERER), hash);
+		hash = hashCString((const char*)glGetString(GL_VERSION), hash);
+		for (unsigned int i = 0; i < numSources; i++)
+		{
+			hash = hashCString(sources[i], hash);
+		}
+		return hash;
+	}
+
+	std::string getProgramCachePath(uint64_t key) {
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "%016llx.ewprog", (unsigned long long)key);
+		return s_programCacheDirectory + "/" + fileName;
+	}
+
+	/// <summary>
+	/// Creates a program from a cached binary. Returns 0 if there is no entry or the driver rejects it,
+	/// in which case the caller compiles from source and the stale file is replaced by saveProgramBinary.
+	/// </summary>
+	unsigned int loadProgramBinary(uint64_t key) {
+		if (s_programCacheDirectory.empty()) {
+			return 0;
+		}
+		std::string cachePath = getProgramCachePath(key);
+		FILE* file = fopen(cachePath.c_str(), "rb");
+		if (file == NULL) {
+			return 0;
+		}
+		ProgramCacheHeader header;
+		std::vector<unsigned char> binary;
+		bool success = fread(&header, sizeof(header), 1, file) == 1
+			&& header.magic == PROGRAM_CACHE_MAGIC
+			&& header.version == PROGRAM_CACHE_VERSION
+			&& header.key == key;
+		if (success) {
+			binary.resize(header.binarySize);
+			success = fread(binary.data(), 1, binary.size(), file) == binary.size();
+		}
+		fclose(file);
+		if (!success) {
+			return 0;
+		}
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, header.binaryFormat, binary.data(), (int)binary.size());
+		int linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			printf("Driver rejected cached program %s, recompiling\n", cachePath.c_str());
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	/// <summary>
+	/// Writes a linked program's binary. The program should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+	/// </summary>
+	bool saveProgramBinary(uint64_t key, unsigned int program) {
+		if (s_programCacheDirectory.empty()) {
+			return false;
+		}
+		int numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		int binarySize = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+		if (numFormats == 0 || binarySize <= 0) {
+			return false;
+		}
+		ProgramCacheHeader header;
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		std::vector<unsigned char> binary(binarySize);
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+		header.binaryFormat = binaryFormat;
+		header.binarySize = (uint32_t)binarySize;
+
+#ifdef _WIN32
+		_mkdir(s_programCacheDirectory.c_str());
+#else
+		mkdir(s_programCacheDirectory.c_str(), 0755);
+#endif
+		std::string cachePath = getProgramCachePath(key);
+		FILE* file = fopen(cachePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write program cache %s\n", cachePath.c_str());
+			return false;
+		}
+		bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+		success = success && fwrite(binary.data(), 1, header.binarySize, file) == header.binarySize;
+		fclose(file);
+		if (!success) {
+			printf("Failed to write program cache %s\n", cachePath.c_str());
+			remove(cachePath.c_str());
+		}
+		return success;
+	}
+}
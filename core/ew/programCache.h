@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+namespace ew {
+	const uint32_t PROGRAM_CACHE_MAGIC = 0x47505745; // "EWPG"
+	const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	//On-disk layout: ProgramCacheHeader followed by binarySize bytes from glGetProgramBinary
+	struct ProgramCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+	};
+
+	//Directory for .ewprog files, created on first write. Empty disables the cache.
+	void setProgramCacheDirectory(const std::string& directory);
+	const std::string& getProgramCacheDirectory();
+	uint64_t getProgramCacheKey(const char* const* sources, unsigned int numSources);
+	std::string getProgramCachePath(uint64_t key);
+	unsigned int loadProgramBinary(uint64_t key);
+	bool saveProgramBinary(uint64_t key, unsigned int program);
+}
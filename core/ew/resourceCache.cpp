@@ -0,0 +1,149 @@
+#include "resourceCache.h"
+#include "compressedTexture.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+
+namespace ew {
+	template<typename T>
+	using ResourceTable = std::unordered_map<std::string, std::weak_ptr<T>>;
+
+	struct ResourceTables {
+		ResourceTable<TextureResource> textures;
+		ResourceTable<Model> models;
+		ResourceTable<Shader> shaders;
+		unsigned int hits = 0;
+		unsigned int misses = 0;
+	};
+
+	//Never destroyed, so handles that outlive main (e.g. in globals) can still evict themselves
+	static ResourceTables& getResourceTables() {
+		static ResourceTables* tables = new ResourceTables();
+		return *tables;
+	}
+
+	/// <summary>
+	/// Returns the live entry for key, or loads a new one whose deleter releases it and removes it from the table
+	/// </summary>
+	template<typename T, typename LoadFn, typename ReleaseFn>
+	static std::shared_ptr<T> acquireResource(ResourceTable<T>& table, const std::string& key, LoadFn load, ReleaseFn release) {
+		ResourceTables& tables = getResourceTables();
+		auto it = table.find(key);
+		if (it != table.end()) {
+			std::shared_ptr<T> existing = it->second.lock();
+			if (existing) {
+				tables.hits++;
+				return existing;
+			}
+		}
+		tables.misses++;
+		ResourceTable<T>* tablePtr = &table;
+		std::shared_ptr<T> resource(load(), [tablePtr, key, release](T* object) {
+			//A new entry may already have replaced this one if it was re-requested after expiring
+			auto it = tablePtr->find(key);
+			if (it != tablePtr->end() && it->second.expired()) {
+				tablePtr->erase(it);
+			}
+			release(object);
+			delete object;
+		});
+		table[key] = resource;
+		return resource;
+	}
+
+	/// <summary>
+	/// Absolute path with . and .. resolved, so different spellings of a file share one cache entry.
+	/// Falls back to the given path if it cannot be resolved.
+	/// </summary>
+	std::string getCanonicalPath(const std::string& filePath) {
+#ifdef _WIN32
+		char buffer[_MAX_PATH];
+		if (_fullpath(buffer, filePath.c_str(), _MAX_PATH) != NULL) {
+			//Windows paths are case insensitive
+			std::string path = buffer;
+			for (size_t i = 0; i < path.size(); i++)
+			{
+				path[i] = path[i] == '/' ? '\\' : (char)tolower((unsigned char)path[i]);
+			}
+			return path;
+		}
+#else
+		char buffer[PATH_MAX];
+		if (realpath(filePath.c_str(), buffer) != NULL) {
+			return buffer;
+		}
+#endif
+		return filePath;
+	}
+
+	TextureHandle acquireTexture(const std::string& filePath, unsigned int placeholderColor) {
+		return acquireTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true, placeholderColor);
+	}
+
+	/// <summary>
+	/// Shares one texture between every request for the same file and sampling parameters.
+	/// New textures load through ew::loadTextureAsync, or synchronously with their stored mips if they are DDS/KTX2.
+	/// </summary>
+	TextureHandle acquireTexture(const std::string& filePath, int wrapMode, int magFilter, int minFilter, bool mipmap, unsigned int placeholderColor) {
+		char params[64];
+		snprintf(params, sizeof(params), "|%d|%d|%d|%d", wrapMode, magFilter, minFilter, mipmap ? 1 : 0);
+		std::string key = getCanonicalPath(filePath) + params;
+		return acquireResource(getResourceTables().textures, key, [&]() {
+			TextureResource* resource = new TextureResource();
+			if (ew::isCompressedTextureFile(filePath.c_str())) {
+				resource->texture = ew::loadCompressedTexture(filePath.c_str(), wrapMode, magFilter, minFilter);
+			}
+			else {
+				resource->texture = ew::loadTextureAsync(filePath.c_str(), wrapMode, magFilter, minFilter, mipmap, placeholderColor);
+			}
+			return resource;
+		}, [](TextureResource* resource) {
+			ew::cancelTextureLoad(resource->texture);
+			glDeleteTextures(1, &resource->texture);
+			ew::invalidateGLState();
+		});
+	}
+
+	/// <summary>
+	/// Shares one model between every request for the same file and load options.
+	/// The thread pool and cache file settings do not change the result, so they are not part of the key.
+	/// </summary>
+	ModelHandle acquireModel(const std::string& filePath, const ModelLoadOptions& options) {
+		char params[96];
+		snprintf(params, sizeof(params), "|%d|%d|%u|%.3f|%d", options.optimize ? 1 : 0, (int)options.vertexFormat,
+			options.numLODs, options.lodReduction, options.buildMeshlets ? 1 : 0);
+		std::string key = getCanonicalPath(filePath) + params;
+		return acquireResource(getResourceTables().models, key, [&]() {
+			return new Model(filePath, options);
+		}, [](Model* model) {
+			model->release();
+		});
+	}
+
+	/// <summary>
+	/// Shares one program between every request for the same pair of stage files
+	/// </summary>
+	ShaderHandle acquireShader(const std::string& vertexShader, const std::string& fragmentShader) {
+		std::string key = getCanonicalPath(vertexShader) + "|" + getCanonicalPath(fragmentShader);
+		return acquireResource(getResourceTables().shaders, key, [&]() {
+			return new Shader(vertexShader, fragmentShader);
+		}, [](Shader* shader) {
+			shader->release();
+		});
+	}
+
+	ResourceCacheStats getResourceCacheStats() {
+		const ResourceTables& tables = getResourceTables();
+		ResourceCacheStats stats;
+		stats.numTextures = (unsigned int)tables.textures.size();
+		stats.numModels = (unsigned int)tables.models.size();
+		stats.numShaders = (unsigned int)tables.shaders.size();
+		stats.hits = tables.hits;
+		stats.misses = tables.misses;
+		return stats;
+	}
+}
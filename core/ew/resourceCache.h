@@ -0,0 +1,34 @@
+#pragma once
+#include "model.h"
+#include "shader.h"
+#include "texture.h"
+#include <memory>
+#include <string>
+
+namespace ew {
+	//A texture owned by the resource cache. Deleted when the last TextureHandle drops.
+	struct TextureResource {
+		unsigned int texture = 0;
+	};
+
+	//Ref-counted handles. Equal requests share one object; the last handle to drop frees the GL objects and evicts the entry.
+	typedef std::shared_ptr<const TextureResource> TextureHandle;
+	typedef std::shared_ptr<Model> ModelHandle;
+	typedef std::shared_ptr<Shader> ShaderHandle;
+
+	struct ResourceCacheStats {
+		unsigned int numTextures = 0;
+		unsigned int numModels = 0;
+		unsigned int numShaders = 0;
+		unsigned int hits = 0; //Requests served from a live entry
+		unsigned int misses = 0; //Requests that loaded from disk
+	};
+
+	//Requests are keyed by canonical file path plus load parameters. GL thread only.
+	TextureHandle acquireTexture(const std::string& filePath, unsigned int placeholderColor = TEXTURE_PLACEHOLDER_GREY);
+	TextureHandle acquireTexture(const std::string& filePath, int wrapMode, int magFilter, int minFilter, bool mipmap, unsigned int placeholderColor = TEXTURE_PLACEHOLDER_GREY);
+	ModelHandle acquireModel(const std::string& filePath, const ModelLoadOptions& options = ModelLoadOptions());
+	ShaderHandle acquireShader(const std::string& vertexShader, const std::string& fragmentShader);
+	ResourceCacheStats getResourceCacheStats();
+	std::string getCanonicalPath(const std::string& filePath);
+}
@@ -3,6 +3,9 @@
 */
 
 #include "shader.h"
+#include "programCache.h"
+#include "glState.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include "external/glad.h"
@@ -26,6 +29,68 @@ namespace ew {
 		return buffer.str();
 	}
 
+	static std::string getDirectory(const std::string& filePath) {
+		size_t slash = filePath.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : filePath.substr(0, slash + 1);
+	}
+
+	/// <summary>
+	/// Appends filePath to output with its #includes expanded in place.
+	/// Each file is included at most once per program source, as if it had #pragma once.
+	/// #line directives keep compiler errors pointing at the right line; the source string number is the index into files.
+	/// </summary>
+	static void expandIncludes(const std::string& filePath, std::string* output, std::vector<std::string>* files, const ShaderDefines* defines) {
+		const int fileIndex = (int)files->size();
+		files->push_back(filePath);
+		std::string source = ew::loadShaderSourceFromFile(filePath);
+		std::istringstream lines(source);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(lines, line)) {
+			lineNumber++;
+			size_t start = line.find_first_not_of(" \t");
+			if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+				size_t open = line.find('"', start + 8);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos) {
+					printf("Malformed #include in %s(%d)\n", filePath.c_str(), lineNumber);
+					output->append("//" + line + "\n");
+					continue;
+				}
+				std::string includePath = getDirectory(filePath) + line.substr(open + 1, close - open - 1);
+				if (std::find(files->begin(), files->end(), includePath) == files->end()) {
+					output->append("#line 1 " + std::to_string(files->size()) + "\n");
+					expandIncludes(includePath, output, files, nullptr);
+				}
+				output->append("#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n");
+				continue;
+			}
+			output->append(line);
+			output->append("\n");
+			//Defines go straight after #version, which must come first
+			if (defines != nullptr && start != std::string::npos && line.compare(start, 8, "#version") == 0) {
+				for (size_t i = 0; i < defines->size(); i++)
+				{
+					output->append("#define " + (*defines)[i].name + " " + (*defines)[i].value + "\n");
+				}
+				output->append("#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n");
+				defines = nullptr;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Loads shader source with #include "path" expanded (relative to the including file) and defines injected after #version
+	/// </summary>
+	/// <param name="filePath">Path to the top level stage file</param>
+	/// <param name="defines">Each becomes #define name value</param>
+	std::string preprocessShaderSource(const std::string& filePath, const ShaderDefines& defines) {
+		std::string output;
+		std::vector<std::string> files;
+		expandIncludes(filePath, &output, &files, &defines);
+		return output;
+	}
+
 	/// <summary>
 	/// Creates and compiles a shader object of a given type
 	/// </summary>
@@ -51,20 +116,43 @@ namespace ew {
 	}
 
 	/// <summary>
-	/// Creates a shader program with a vertex and fragment shader
+	/// Creates a shader program with a vertex and fragment shader.
+	/// Reuses a cached program binary when one exists for these sources and this driver.
 	/// </summary>
 	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
 	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
 	/// <returns></returns>
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+		return createShaderProgram(vertexShaderSource, nullptr, fragmentShaderSource);
+	}
+	/// <summary>
+	/// Creates a program with vertex, geometry and fragment stages. A null geometry source leaves that stage out.
+	/// </summary>
+	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
+	/// <param name="geometryShaderSource">GLSL source code for the geometry shader, or nullptr</param>
+	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* geometryShaderSource, const char* fragmentShaderSource) {
+		//Vertex + fragment programs keep the cache key they always had
+		const char* sources[3] = { vertexShaderSource, fragmentShaderSource, geometryShaderSource };
+		uint64_t cacheKey = ew::getProgramCacheKey(sources, geometryShaderSource != nullptr ? 3 : 2);
+		unsigned int cachedProgram = ew::loadProgramBinary(cacheKey);
+		if (cachedProgram != 0) {
+			return cachedProgram;
+		}
+
 		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
+		unsigned int geometryShader = geometryShaderSource != nullptr ? createShader(GL_GEOMETRY_SHADER, geometryShaderSource) : 0;
 		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
 
 		unsigned int shaderProgram = glCreateProgram();
 		//Attach each stage
 		glAttachShader(shaderProgram, vertexShader);
+		if (geometryShader != 0) {
+			glAttachShader(shaderProgram, geometryShader);
+		}
 		glAttachShader(shaderProgram, fragmentShader);
-		//Link all the stages together
+		//Ask for a binary we can cache, then link all the stages together
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(shaderProgram);
 		int success;
 		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
@@ -73,61 +161,263 @@ namespace ew {
 			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
 			printf("Failed to link shader program: %s", infoLog);
 		}
+		else {
+			ew::saveProgramBinary(cacheKey, shaderProgram);
+		}
 		//The linked program now contains our compiled code, so we can delete these intermediate objects
 		glDeleteShader(vertexShader);
+		glDeleteShader(geometryShader);
 		glDeleteShader(fragmentShader);
 		return shaderProgram;
 	}
 	/// <summary>
+	/// Creates a program with a single compute stage. Cached like createShaderProgram.
+	/// </summary>
+	/// <param name="computeShaderSource">GLSL source code for the compute shader</param>
+	unsigned int createComputeProgram(const char* computeShaderSource) {
+		uint64_t cacheKey = ew::getProgramCacheKey(&computeShaderSource, 1);
+		unsigned int cachedProgram = ew::loadProgramBinary(cacheKey);
+		if (cachedProgram != 0) {
+			return cachedProgram;
+		}
+
+		unsigned int computeShader = createShader(GL_COMPUTE_SHADER, computeShaderSource);
+		unsigned int shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, computeShader);
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(shaderProgram);
+		int success;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			printf("Failed to link compute program: %s", infoLog);
+		}
+		else {
+			ew::saveProgramBinary(cacheKey, shaderProgram);
+		}
+		glDeleteShader(computeShader);
+		return shaderProgram;
+	}
+	/// <summary>
 	/// Creates a shader instance with vertex + fragment stages
 	/// </summary>
 	/// <param name="vertexShader">File path to vertex shader</param>
 	/// <param name="fragmentShader">File path to fragment shader</param>
-	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader)
+	/// <param name="defines">Injected into both stages by ew::preprocessShaderSource</param>
+	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader, const ShaderDefines& defines)
 	{
-		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
-		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
+		std::string vertexShaderSource = ew::preprocessShaderSource(vertexShader, defines);
+		std::string fragmentShaderSource = ew::preprocessShaderSource(fragmentShader, defines);
 		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		loadUniforms();
+	}
+
+	/// <summary>
+	/// Creates a shader instance with a single compute stage
+	/// </summary>
+	/// <param name="computeShader">File path to compute shader</param>
+	/// <param name="defines">Injected by ew::preprocessShaderSource</param>
+	Shader Shader::compute(const std::string& computeShader, const ShaderDefines& defines)
+	{
+		std::string computeShaderSource = ew::preprocessShaderSource(computeShader, defines);
+		Shader shader;
+		shader.m_id = ew::createComputeProgram(computeShaderSource.c_str());
+		shader.loadUniforms();
+		return shader;
+	}
+
+	/// <summary>
+	/// Creates a shader instance with vertex + geometry + fragment stages
+	/// </summary>
+	/// <param name="vertexShader">File path to vertex shader</param>
+	/// <param name="geometryShader">File path to geometry shader</param>
+	/// <param name="fragmentShader">File path to fragment shader</param>
+	/// <param name="defines">Injected into every stage by ew::preprocessShaderSource</param>
+	Shader Shader::geometry(const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader, const ShaderDefines& defines)
+	{
+		std::string vertexShaderSource = ew::preprocessShaderSource(vertexShader, defines);
+		std::string geometryShaderSource = ew::preprocessShaderSource(geometryShader, defines);
+		std::string fragmentShaderSource = ew::preprocessShaderSource(fragmentShader, defines);
+		Shader shader;
+		shader.m_id = ew::createShaderProgram(vertexShaderSource.c_str(), geometryShaderSource.c_str(), fragmentShaderSource.c_str());
+		shader.loadUniforms();
+		return shader;
+	}
+
+	static UniformType getUniformType(GLenum type) {
+		switch (type) {
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+			return UniformType::Int;
+		case GL_FLOAT:
+			return UniformType::Float;
+		case GL_FLOAT_VEC2:
+			return UniformType::Vec2;
+		case GL_FLOAT_VEC3:
+			return UniformType::Vec3;
+		case GL_FLOAT_VEC4:
+			return UniformType::Vec4;
+		case GL_FLOAT_MAT4:
+			return UniformType::Mat4;
+		default:
+			return UniformType::Other;
+		}
+	}
+
+	/// <summary>
+	/// Reads every active uniform's location once, so setting uniforms never asks the driver to look up a string.
+	/// Arrays of basic types are registered by bare name and by each element.
+	/// </summary>
+	void Shader::loadUniforms()
+	{
+		m_uniforms.clear();
+		int numUniforms = 0, maxNameLength = 0;
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+		std::vector<char> nameBuffer(maxNameLength + 1);
+		for (int i = 0; i < numUniforms; i++)
+		{
+			int size = 0, length = 0;
+			GLenum glType;
+			glGetActiveUniform(m_id, i, (int)nameBuffer.size(), &length, &size, &glType, nameBuffer.data());
+			std::string name(nameBuffer.data(), length);
+			int location = glGetUniformLocation(m_id, name.c_str());
+			//Uniform block members have no location
+			if (location < 0) {
+				continue;
+			}
+			UniformType type = getUniformType(glType);
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+				std::string baseName = name.substr(0, name.size() - 3);
+				m_uniforms.push_back({ hashUniformName(baseName.c_str()), location, type, baseName });
+				for (int e = 0; e < size; e++)
+				{
+					std::string elementName = baseName + "[" + std::to_string(e) + "]";
+					m_uniforms.push_back({ hashUniformName(elementName.c_str()), glGetUniformLocation(m_id, elementName.c_str()), type, elementName });
+				}
+			}
+			else {
+				m_uniforms.push_back({ hashUniformName(name.c_str()), location, type, name });
+			}
+		}
+		std::sort(m_uniforms.begin(), m_uniforms.end(), [](const UniformEntry& a, const UniformEntry& b) {
+			return a.hash < b.hash;
+		});
+	}
+
+	/// <summary>
+	/// Location of an active uniform from the table read at link time, or -1 (ignored by glUniform*) if it is not active
+	/// </summary>
+	int Shader::getUniformLocation(UniformName name) const
+	{
+		return getUniformLocation(name, UniformType::Other);
+	}
+
+	int Shader::getUniformLocation(UniformName name, UniformType expectedType) const
+	{
+		auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name.hash, [](const UniformEntry& entry, uint32_t hash) {
+			return entry.hash < hash;
+		});
+		//Names are compared too, so a hash collision can never alias two uniforms
+		for (; it != m_uniforms.end() && it->hash == name.hash; ++it)
+		{
+			if (it->name == name.name) {
+				if (expectedType != UniformType::Other && it->type != UniformType::Other && it->type != expectedType) {
+					printf("Uniform %s does not match the requested type\n", name.name);
+				}
+				return it->location;
+			}
+		}
+		return -1;
 	}
 	void Shader::use()const
 	{
-		glUseProgram(m_id);
+		ew::useProgram(m_id);
+	}
+	/// <summary>
+	/// Binds this compute program and launches a grid of work groups
+	/// </summary>
+	void Shader::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)const
+	{
+		ew::useProgram(m_id);
+		glDispatchCompute(groupsX, groupsY, groupsZ);
+	}
+	/// <summary>
+	/// Deletes the program. Shader is a plain handle that may be copied, so this is never called implicitly.
+	/// </summary>
+	void Shader::release()
+	{
+		glDeleteProgram(m_id);
+		ew::invalidateGLState();
+		m_id = 0;
+		m_uniforms.clear();
+	}
+	void Shader::set(UniformHandle<int> uniform, int v) const
+	{
+		glUniform1i(uniform.location, v);
+	}
+	void Shader::set(UniformHandle<float> uniform, float v) const
+	{
+		glUniform1f(uniform.location, v);
+	}
+	void Shader::set(UniformHandle<glm::vec2> uniform, const glm::vec2& v) const
+	{
+		glUniform2f(uniform.location, v.x, v.y);
+	}
+	void Shader::set(UniformHandle<glm::vec3> uniform, const glm::vec3& v) const
+	{
+		glUniform3f(uniform.location, v.x, v.y, v.z);
+	}
+	void Shader::set(UniformHandle<glm::vec4> uniform, const glm::vec4& v) const
+	{
+		glUniform4f(uniform.location, v.x, v.y, v.z, v.w);
+	}
+	void Shader::set(UniformHandle<glm::mat4> uniform, const glm::mat4& m) const
+	{
+		glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(m));
 	}
-	void Shader::setInt(const std::string& name, int v) const
+	void Shader::setInt(UniformName name, int v) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1i(getUniformLocation(name), v);
 	}
-	void Shader::setFloat(const std::string& name, float v) const
+	void Shader::setFloat(UniformName name, float v) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1f(getUniformLocation(name), v);
 	}
-	void Shader::setVec2(const std::string& name, float x, float y) const
+	void Shader::setVec2(UniformName name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		glUniform2f(getUniformLocation(name), x, y);
 	}
-	void Shader::setVec2(const std::string& name, const glm::vec2& v) const
+	void Shader::setVec2(UniformName name, const glm::vec2& v) const
 	{
 		setVec2(name, v.x, v.y);
 	}
-	void Shader::setVec3(const std::string& name, float x, float y, float z) const
+	void Shader::setVec3(UniformName name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		glUniform3f(getUniformLocation(name), x, y, z);
 	}
-	void Shader::setVec3(const std::string& name, const glm::vec3& v) const
+	void Shader::setVec3(UniformName name, const glm::vec3& v) const
 	{
 		setVec3(name, v.x, v.y, v.z);
 	}
-	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
+	void Shader::setVec4(UniformName name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		glUniform4f(getUniformLocation(name), x, y, z, w);
 	}
-	void Shader::setVec4(const std::string& name, const glm::vec4& v) const
+	void Shader::setVec4(UniformName name, const glm::vec4& v) const
 	{
 		setVec4(name, v.x, v.y, v.z, v.w);
 	}
-	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
+	void Shader::setMat4(UniformName name, const glm::mat4& m) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+		glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(m));
 	}
 }
 
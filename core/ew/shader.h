@@ -3,26 +3,113 @@
 */
 
 #pragma once
+#include <stdint.h>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include <glm/glm.hpp>
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
+
+	struct ShaderDefine {
+		ShaderDefine(const std::string& name, const std::string& value = "") : name(name), value(value) {}
+		ShaderDefine(const std::string& name, int value) : name(name), value(std::to_string(value)) {}
+		std::string name;
+		std::string value;
+	};
+	typedef std::vector<ShaderDefine> ShaderDefines;
+
+	std::string preprocessShaderSource(const std::string& filePath, const ShaderDefines& defines = ShaderDefines());
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* geometryShaderSource, const char* fragmentShaderSource);
+	unsigned int createComputeProgram(const char* computeShaderSource);
+
+	//32 bit FNV-1a. constexpr so UniformName can hash string literals at compile time.
+	constexpr uint32_t hashUniformName(const char* name, uint32_t hash = 2166136261u) {
+		return *name == '\0' ? hash : hashUniformName(name + 1, (hash ^ (uint32_t)(unsigned char)*name) * 16777619u);
+	}
+
+	//A uniform name and its hash. Built implicitly from string literals, C strings and std::strings.
+	//Only lives for the call it is passed to, so it may point into a temporary string.
+	//Literals are hashed by the compiler in every build: the constructor is consteval, so it can not fall back to runtime.
+	struct UniformName {
+		template<size_t N>
+		consteval UniformName(const char(&literal)[N]) : name(literal), hash(hashUniformName(literal)) {}
+		template<typename T, typename std::enable_if<std::is_convertible<T, const char*>::value && !std::is_array<T>::value, int>::type = 0>
+		UniformName(const T& name) : name(name), hash(hashUniformName(name)) {}
+		UniformName(const std::string& name) : name(name.c_str()), hash(hashUniformName(name.c_str())) {}
+		const char* name;
+		uint32_t hash;
+	};
+
+	enum class UniformType {
+		Int, //Also bools and samplers
+		Float,
+		Vec2,
+		Vec3,
+		Vec4,
+		Mat4,
+		Other
+	};
+	template<typename T> struct UniformTypeOf;
+	template<> struct UniformTypeOf<int> { static const UniformType value = UniformType::Int; };
+	template<> struct UniformTypeOf<float> { static const UniformType value = UniformType::Float; };
+	template<> struct UniformTypeOf<glm::vec2> { static const UniformType value = UniformType::Vec2; };
+	template<> struct UniformTypeOf<glm::vec3> { static const UniformType value = UniformType::Vec3; };
+	template<> struct UniformTypeOf<glm::vec4> { static const UniformType value = UniformType::Vec4; };
+	template<> struct UniformTypeOf<glm::mat4> { static const UniformType value = UniformType::Mat4; };
+
+	//A uniform location resolved once with Shader::getUniform. Only valid for the program it came from.
+	template<typename T>
+	struct UniformHandle {
+		int location = -1;
+		inline bool isValid()const { return location >= 0; }
+	};
+
 	class Shader {
 	public:
-		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		Shader() : m_id(0) {}; //Empty until built by a ShaderBatch
+		Shader(const std::string& vertexShader, const std::string& fragmentShader, const ShaderDefines& defines = ShaderDefines());
+		static Shader compute(const std::string& computeShader, const ShaderDefines& defines = ShaderDefines());
+		static Shader geometry(const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader, const ShaderDefines& defines = ShaderDefines());
 		void use()const;
-		void setInt(const std::string& name, int v) const;
-		void setFloat(const std::string& name, float v) const;
-		void setVec2(const std::string& name, float x, float y) const;
-		void setVec2(const std::string& name, const glm::vec2& v) const;
-		void setVec3(const std::string& name, float x, float y, float z) const;
-		void setVec3(const std::string& name, const glm::vec3& v) const;
-		void setVec4(const std::string& name, float x, float y, float z, float w) const;
-		void setVec4(const std::string& name, const glm::vec4& v) const;
-		void setMat4(const std::string& name, const glm::mat4& m) const;
+		void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1)const;
+		void release();
+		inline unsigned int getId()const { return m_id; }
+		int getUniformLocation(UniformName name) const;
+		template<typename T>
+		UniformHandle<T> getUniform(UniformName name) const {
+			UniformHandle<T> handle;
+			handle.location = getUniformLocation(name, UniformTypeOf<T>::value);
+			return handle;
+		}
+		void set(UniformHandle<int> uniform, int v) const;
+		void set(UniformHandle<float> uniform, float v) const;
+		void set(UniformHandle<glm::vec2> uniform, const glm::vec2& v) const;
+		void set(UniformHandle<glm::vec3> uniform, const glm::vec3& v) const;
+		void set(UniformHandle<glm::vec4> uniform, const glm::vec4& v) const;
+		void set(UniformHandle<glm::mat4> uniform, const glm::mat4& m) const;
+		void setInt(UniformName name, int v) const;
+		void setFloat(UniformName name, float v) const;
+		void setVec2(UniformName name, float x, float y) const;
+		void setVec2(UniformName name, const glm::vec2& v) const;
+		void setVec3(UniformName name, float x, float y, float z) const;
+		void setVec3(UniformName name, const glm::vec3& v) const;
+		void setVec4(UniformName name, float x, float y, float z, float w) const;
+		void setVec4(UniformName name, const glm::vec4& v) const;
+		void setMat4(UniformName name, const glm::mat4& m) const;
 	private:
+		friend class ShaderBatch;
+		struct UniformEntry {
+			uint32_t hash;
+			int location;
+			UniformType type;
+			std::string name;
+		};
+		void loadUniforms();
+		int getUniformLocation(UniformName name, UniformType expectedType) const;
 		unsigned int m_id; //Shader program handle
+		std::vector<UniformEntry> m_uniforms; //Active uniforms sorted by hash, read once after linking
 	};
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "shaderBatch.h"
+#include "programCache.h"
+#include "external/glad.h"
+#include <GLFW/glfw3.h>
+#include <string.h>
+
+//GL_KHR_parallel_shader_compile is not in the generated glad headers
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+namespace ew {
+	/// <summary>
+	/// True if the driver exposes KHR or ARB parallel shader compile. Also raises its compiler thread count to the maximum the first time.
+	/// </summary>
+	bool isParallelShaderCompileSupported() {
+		static int supported = -1;
+		if (supported >= 0) {
+			return supported == 1;
+		}
+		supported = 0;
+		int numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		const char* maxThreadsFunction = NULL;
+		for (int i = 0; i < numExtensions; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0) {
+				maxThreadsFunction = "glMaxShaderCompilerThreadsKHR";
+				break;
+			}
+			if (strcmp(extension, "GL_ARB_parallel_shader_compile") == 0) {
+				maxThreadsFunction = "glMaxShaderCompilerThreadsARB";
+			}
+		}
+		if (maxThreadsFunction == NULL) {
+			return false;
+		}
+		supported = 1;
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(maxThreadsFunction);
+		if (maxShaderCompilerThreads != NULL) {
+			//0xFFFFFFFF lets the driver pick how many threads to use
+			maxShaderCompilerThreads(0xFFFFFFFF);
+		}
+		return true;
+	}
+
+	static unsigned int startCompile(GLenum shaderType, const char* sourceCode) {
+		unsigned int shader = glCreateShader(shaderType);
+		glShaderSource(shader, 1, &sourceCode, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	static void printShaderLog(unsigned int shader, const std::string& name) {
+		int success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			printf("Failed to compile shader %s: %s", name.c_str(), infoLog);
+		}
+	}
+
+	ShaderBatch::ShaderBatch() {
+		isParallelShaderCompileSupported();
+	}
+
+	ShaderBatch::~ShaderBatch() {
+		finish();
+	}
+
+	/// <summary>
+	/// Starts building a program into shader. Cached binaries are used as is; everything else is compiled and linked without waiting.
+	/// shader must stay alive until finish(), and should not be used or copied before then.
+	/// </summary>
+	void ShaderBatch::add(Shader* shader, const std::string& vertexShader, const std::string& fragmentShader, const ShaderDefines& defines) {
+		addGeometry(shader, vertexShader, "", fragmentShader, defines);
+	}
+
+	/// <summary>
+	/// As add, with a geometry stage between the vertex and fragment shaders. An empty geometryShader path leaves it out.
+	/// </summary>
+	void ShaderBatch::addGeometry(Shader* shader, const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader, const ShaderDefines& defines) {
+		std::string vertexShaderSource = ew::preprocessShaderSource(vertexShader, defines);
+		std::string geometryShaderSource = geometryShader.empty() ? "" : ew::preprocessShaderSource(geometryShader, defines);
+		std::string fragmentShaderSource = ew::preprocessShaderSource(fragmentShader, defines);
+		//Same order and key as createShaderProgram, so both share cached binaries
+		const char* sources[3] = { vertexShaderSource.c_str(), fragmentShaderSource.c_str(), geometryShaderSource.c_str() };
+		PendingProgram pending;
+		pending.shader = shader;
+		pending.cacheKey = ew::getProgramCacheKey(sources, geometryShader.empty() ? 2 : 3);
+		pending.name = geometryShader.empty() ? vertexShader + " + " + fragmentShader : vertexShader + " + " + geometryShader + " + " + fragmentShader;
+		pending.vertexShader = 0;
+		pending.geometryShader = 0;
+		pending.fragmentShader = 0;
+		pending.program = ew::loadProgramBinary(pending.cacheKey);
+		if (pending.program == 0) {
+			pending.vertexShader = startCompile(GL_VERTEX_SHADER, sources[0]);
+			pending.geometryShader = geometryShader.empty() ? 0 : startCompile(GL_GEOMETRY_SHADER, sources[2]);
+			pending.fragmentShader = startCompile(GL_FRAGMENT_SHADER, sources[1]);
+			pending.program = glCreateProgram();
+			glAttachShader(pending.program, pending.vertexShader);
+			if (pending.geometryShader != 0) {
+				glAttachShader(pending.program, pending.geometryShader);
+			}
+			glAttachShader(pending.program, pending.fragmentShader);
+			glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(pending.program);
+		}
+		shader->m_id = pending.program;
+		m_pending.push_back(pending);
+	}
+
+	/// <summary>
+	/// Polls without blocking. Always true when parallel compile is unsupported, since then any query waits for the driver.
+	/// </summary>
+	bool ShaderBatch::isComplete()const {
+		if (!isParallelShaderCompileSupported()) {
+			return true;
+		}
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			int complete = 1;
+			glGetProgramiv(m_pending[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+			if (!complete) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Waits for every program, prints compile and link errors, caches new binaries and fills in uniform tables.
+	/// </summary>
+	/// <returns>Number of programs that failed to build</returns>
+	unsigned int ShaderBatch::finish() {
+		unsigned int numFailed = 0;
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			PendingProgram& pending = m_pending[i];
+			int success;
+			glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+			//Programs loaded from the binary cache have no shader objects
+			if (pending.vertexShader != 0) {
+				if (!success) {
+					printShaderLog(pending.vertexShader, pending.name);
+					if (pending.geometryShader != 0) {
+						printShaderLog(pending.geometryShader, pending.name);
+					}
+					printShaderLog(pending.fragmentShader, pending.name);
+					char infoLog[512];
+					glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
+					printf("Failed to link shader program %s: %s", pending.name.c_str(), infoLog);
+				}
+				else {
+					ew::saveProgramBinary(pending.cacheKey, pending.program);
+				}
+				glDeleteShader(pending.vertexShader);
+				glDeleteShader(pending.geometryShader);
+				glDeleteShader(pending.fragmentShader);
+			}
+			numFailed += success ? 0 : 1;
+			pending.shader->loadUniforms();
+		}
+		m_pending.clear();
+		return numFailed;
+	}
+}
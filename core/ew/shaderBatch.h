@@ -0,0 +1,37 @@
+#pragma once
+#include "shader.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Builds many programs at once. Every compile and link is issued up front without querying status,
+	/// so the driver can work on them in parallel (GL_KHR_parallel_shader_compile) while the app does other loading.
+	/// Errors are collected in finish().
+	/// </summary>
+	class ShaderBatch {
+	public:
+		ShaderBatch();
+		~ShaderBatch();
+		void add(Shader* shader, const std::string& vertexShader, const std::string& fragmentShader, const ShaderDefines& defines = ShaderDefines());
+		void addGeometry(Shader* shader, const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader, const ShaderDefines& defines = ShaderDefines());
+		bool isComplete()const;
+		unsigned int finish();
+	private:
+		ShaderBatch(const ShaderBatch&) = delete;
+		ShaderBatch& operator=(const ShaderBatch&) = delete;
+		struct PendingProgram {
+			Shader* shader;
+			unsigned int program;
+			unsigned int vertexShader;
+			unsigned int geometryShader; //0 for vertex + fragment programs
+			unsigned int fragmentShader;
+			uint64_t cacheKey;
+			std::string name; //For error messages
+		};
+		std::vector<PendingProgram> m_pending;
+	};
+
+	bool isParallelShaderCompileSupported();
+}
@@ -0,0 +1,64 @@
+#include "shaderPermutations.h"
+#include <algorithm>
+
+namespace ew {
+	ShaderPermutations::ShaderPermutations(const std::string& vertexShader, const std::string& fragmentShader)
+		: m_vertexShader(vertexShader), m_fragmentShader(fragmentShader)
+	{
+	}
+
+	//Sorts defines by name and builds the variant key from them
+	static std::string getVariantKey(const ShaderDefines& defines, ShaderDefines* sorted)
+	{
+		*sorted = defines;
+		std::sort(sorted->begin(), sorted->end(), [](const ShaderDefine& a, const ShaderDefine& b) {
+			return a.name < b.name;
+		});
+		std::string key;
+		for (size_t i = 0; i < sorted->size(); i++)
+		{
+			key += (*sorted)[i].name + "=" + (*sorted)[i].value + ";";
+		}
+		return key;
+	}
+
+	/// <summary>
+	/// Returns the variant for these defines, building it on first use. Define order does not matter.
+	/// The reference stays valid until release().
+	/// </summary>
+	const Shader& ShaderPermutations::get(const ShaderDefines& defines)
+	{
+		ShaderDefines sorted;
+		std::string key = getVariantKey(defines, &sorted);
+		auto it = m_variants.find(key);
+		if (it == m_variants.end()) {
+			it = m_variants.emplace(key, Shader(m_vertexShader, m_fragmentShader, sorted)).first;
+		}
+		return it->second;
+	}
+
+	/// <summary>
+	/// Queues a variant on a batch, so it builds with the rest of the loading instead of stalling the first get().
+	/// Like any batched shader, it must not be requested before batch->finish().
+	/// </summary>
+	void ShaderPermutations::prewarm(ShaderBatch* batch, const ShaderDefines& defines)
+	{
+		ShaderDefines sorted;
+		std::string key = getVariantKey(defines, &sorted);
+		if (m_variants.find(key) != m_variants.end()) {
+			return;
+		}
+		//Map nodes never move, so the batch can hold on to the shader
+		Shader& shader = m_variants[key];
+		batch->add(&shader, m_vertexShader, m_fragmentShader, sorted);
+	}
+
+	void ShaderPermutations::release()
+	{
+		for (auto& variant : m_variants)
+		{
+			variant.second.release();
+		}
+		m_variants.clear();
+	}
+}
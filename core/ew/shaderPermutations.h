@@ -0,0 +1,24 @@
+#pragma once
+#include "shader.h"
+#include "shaderBatch.h"
+#include <string>
+#include <unordered_map>
+
+namespace ew {
+	/// <summary>
+	/// Specialized variants of one vertex + fragment pair, each built with its own set of defines the first time it is requested.
+	/// Fixed counts and switches let the compiler unroll loops and strip dead branches instead of branching per pixel.
+	/// </summary>
+	class ShaderPermutations {
+	public:
+		ShaderPermutations(const std::string& vertexShader, const std::string& fragmentShader);
+		const Shader& get(const ShaderDefines& defines);
+		void prewarm(ShaderBatch* batch, const ShaderDefines& defines);
+		inline size_t getNumVariants()const { return m_variants.size(); }
+		void release();
+	private:
+		std::string m_vertexShader;
+		std::string m_fragmentShader;
+		std::unordered_map<std::string, Shader> m_variants; //Keyed by sorted "NAME=VALUE;" list
+	};
+}
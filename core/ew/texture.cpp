@@ -3,8 +3,16 @@
 */
 
 #include "texture.h"
+#include "threadPool.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <vector>
 
 static int getTextureFormat(int numComponents) {
 	switch (numComponents) {
@@ -54,5 +62,203 @@ namespace ew {
 		stbi_image_free(data);
 		return texture;
 	}
-}
 
+	//An async load between loadTextureAsync and its upload. Pixel fields are written by a worker, then read on the GL thread.
+	struct PendingTexture {
+		unsigned int texture = 0;
+		std::string filePath;
+		int magFilter, minFilter;
+		bool mipmap;
+		bool decoded = false;
+		bool cancelled = false; //Texture was deleted before upload; pixels are freed without uploading
+		unsigned char* pixels = nullptr; //Owned by stb_image. Null after decoding if the load failed
+		int width = 0, height = 0, numComponents = 0;
+	};
+
+	static std::mutex s_pendingMutex;
+	static std::condition_variable s_decodedCondition;
+	static std::vector<std::shared_ptr<PendingTexture>> s_pendingTextures;
+
+	//Upload PBOs are reused round robin and orphaned on each use, so a new copy never waits on the previous one
+	static const int NUM_UPLOAD_BUFFERS = 4;
+	static unsigned int s_uploadBuffers[NUM_UPLOAD_BUFFERS] = {};
+	static int s_nextUploadBuffer = 0;
+
+	unsigned int loadTextureAsync(const char* filePath, unsigned int placeholderColor) {
+		return loadTextureAsync(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true, placeholderColor);
+	}
+
+	/// <summary>
+	/// Creates a texture showing a 1x1 placeholder and queues the file for decoding on a worker thread.
+	/// Call updateTextureLoads once per frame to upload finished images into it.
+	/// </summary>
+	/// <param name="filePath">Image to load</param>
+	/// <param name="placeholderColor">RGBA color shown until the image is resident, red in the low byte</param>
+	/// <returns>Texture name. Stays the same once the image is uploaded</returns>
+	unsigned int loadTextureAsync(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap, unsigned int placeholderColor) {
+		int previousTexture;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		//Mutable storage, so the real image can replace the placeholder under the same name
+		unsigned char placeholder[4];
+		memcpy(placeholder, &placeholderColor, sizeof(placeholder));
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+
+		std::shared_ptr<PendingTexture> pending = std::make_shared<PendingTexture>();
+		pending->texture = texture;
+		pending->filePath = filePath;
+		pending->magFilter = magFilter;
+		pending->minFilter = minFilter;
+		pending->mipmap = mipmap;
+		{
+			std::lock_guard<std::mutex> lock(s_pendingMutex);
+			s_pendingTextures.push_back(pending);
+		}
+		ew::getWorkerPool().submit([pending]() {
+			int width, height, numComponents;
+			unsigned char* pixels = stbi_load(pending->filePath.c_str(), &width, &height, &numComponents, 0);
+			{
+				std::lock_guard<std::mutex> lock(s_pendingMutex);
+				pending->pixels = pixels;
+				pending->width = width;
+				pending->height = height;
+				pending->numComponents = numComponents;
+				pending->decoded = true;
+			}
+			s_decodedCondition.notify_all();
+		});
+		return texture;
+	}
+
+	/// <summary>
+	/// Copies a decoded image into a PBO and respecifies the texture from it. The driver finishes the transfer asynchronously.
+	/// </summary>
+	static void uploadPendingTexture(const PendingTexture& pending) {
+		if (pending.pixels == NULL) {
+			printf("Failed to load image %s", pending.filePath.c_str());
+			return;
+		}
+		const size_t size = (size_t)pending.width * pending.height * pending.numComponents;
+		if (s_uploadBuffers[0] == 0) {
+			glGenBuffers(NUM_UPLOAD_BUFFERS, s_uploadBuffers);
+		}
+		unsigned int uploadBuffer = s_uploadBuffers[s_nextUploadBuffer];
+		s_nextUploadBuffer = (s_nextUploadBuffer + 1) % NUM_UPLOAD_BUFFERS;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped == NULL) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			printf("Failed to map upload buffer for %s", pending.filePath.c_str());
+			return;
+		}
+		memcpy(mapped, pending.pixels, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		int previousTexture;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		glBindTexture(GL_TEXTURE_2D, pending.texture);
+		int format = getTextureFormat(pending.numComponents);
+		//Rows are tightly packed, which RGB images with odd widths are not under the default alignment of 4
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, pending.width, pending.height, 0, format, GL_UNSIGNED_BYTE, (const void*)0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (pending.mipmap) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+	}
+
+	/// <summary>
+	/// Uploads textures whose decode has finished. Call once per frame on the GL thread.
+	/// </summary>
+	/// <param name="maxUploadBytes">Stop after this many bytes have been uploaded this call. 0 uploads everything ready.
+	/// At least one texture is uploaded per call regardless, so large images still get through.</param>
+	/// <returns>Number of textures still pending</returns>
+	unsigned int updateTextureLoads(size_t maxUploadBytes) {
+		std::vector<std::shared_ptr<PendingTexture>> ready;
+		unsigned int numPending;
+		{
+			std::lock_guard<std::mutex> lock(s_pendingMutex);
+			size_t budget = 0;
+			for (size_t i = 0; i < s_pendingTextures.size();)
+			{
+				const PendingTexture& pending = *s_pendingTextures[i];
+				if (!pending.decoded || (maxUploadBytes > 0 && !ready.empty() && budget >= maxUploadBytes)) {
+					i++;
+					continue;
+				}
+				budget += (size_t)pending.width * pending.height * pending.numComponents;
+				ready.push_back(s_pendingTextures[i]);
+				s_pendingTextures.erase(s_pendingTextures.begin() + i);
+			}
+			numPending = (unsigned int)s_pendingTextures.size();
+		}
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			if (!ready[i]->cancelled) {
+				uploadPendingTexture(*ready[i]);
+			}
+			stbi_image_free(ready[i]->pixels);
+			ready[i]->pixels = nullptr;
+		}
+		return numPending;
+	}
+
+	/// <summary>
+	/// Blocks until every queued texture has been decoded and uploaded. Call on the GL thread.
+	/// </summary>
+	void finishTextureLoads() {
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(s_pendingMutex);
+				s_decodedCondition.wait(lock, []() {
+					return std::all_of(s_pendingTextures.begin(), s_pendingTextures.end(), [](const std::shared_ptr<PendingTexture>& pending) {
+						return pending->decoded;
+					});
+				});
+			}
+			if (updateTextureLoads() == 0) {
+				return;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Stops a pending async load from uploading into its texture. Call before deleting a texture that may still be loading.
+	/// </summary>
+	void cancelTextureLoad(unsigned int texture) {
+		std::lock_guard<std::mutex> lock(s_pendingMutex);
+		for (size_t i = 0; i < s_pendingTextures.size(); i++)
+		{
+			if (s_pendingTextures[i]->texture == texture) {
+				s_pendingTextures[i]->cancelled = true;
+			}
+		}
+	}
+
+	/// <summary>
+	/// False while an async load is still decoding or waiting for upload
+	/// </summary>
+	bool isTextureResident(unsigned int texture) {
+		std::lock_guard<std::mutex> lock(s_pendingMutex);
+		for (size_t i = 0; i < s_pendingTextures.size(); i++)
+		{
+			//Cancelled loads are skipped, since the deleted name may already have been reused
+			if (s_pendingTextures[i]->texture == texture && !s_pendingTextures[i]->cancelled) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -3,8 +3,22 @@
 */
 
 #pragma once
+#include <stddef.h>
 
 namespace ew {
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+
+	//Placeholder colors for loadTextureAsync, packed RGBA with red in the low byte
+	const unsigned int TEXTURE_PLACEHOLDER_GREY = 0xFF808080;
+	const unsigned int TEXTURE_PLACEHOLDER_NORMAL = 0xFFFF8080; //Flat tangent space normal
+
+	//Async loads decode on ew::getWorkerPool() and upload through pixel buffer objects in updateTextureLoads.
+	//The returned texture name is valid and bindable right away; it shows the placeholder until its image is resident.
+	unsigned int loadTextureAsync(const char* filePath, unsigned int placeholderColor = TEXTURE_PLACEHOLDER_GREY);
+	unsigned int loadTextureAsync(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap, unsigned int placeholderColor = TEXTURE_PLACEHOLDER_GREY);
+	unsigned int updateTextureLoads(size_t maxUploadBytes = 0);
+	void finishTextureLoads();
+	bool isTextureResident(unsigned int texture);
+	void cancelTextureLoad(unsigned int texture);
 }
@@ -0,0 +1,270 @@
+#include "textureEncoder.h"
+#include "threadPool.h"
+#include <float.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	static uint16_t packRGB565(const glm::vec3& color) {
+		glm::vec3 c = glm::clamp(color, 0.0f, 255.0f);
+		uint16_t r = (uint16_t)(c.r * 31.0f / 255.0f + 0.5f);
+		uint16_t g = (uint16_t)(c.g * 63.0f / 255.0f + 0.5f);
+		uint16_t b = (uint16_t)(c.b * 31.0f / 255.0f + 0.5f);
+		return (r << 11) | (g << 5) | b;
+	}
+
+	static glm::vec3 unpackRGB565(uint16_t color) {
+		return glm::vec3((color >> 11) & 31, (color >> 5) & 63, color & 31) * glm::vec3(255.0f / 31.0f, 255.0f / 63.0f, 255.0f / 31.0f);
+	}
+
+	/// <summary>
+	/// BC1 color block. Endpoints are the extremes of the texels along their principal axis (range fit).
+	/// Always emits 4 color mode (color0 > color1), which is also what BC3 expects.
+	/// </summary>
+	static void encodeColorBlock(const unsigned char texels[16][4], unsigned char* out) {
+		glm::vec3 colors[16];
+		glm::vec3 mean = glm::vec3(0.0f);
+		for (int i = 0; i < 16; i++)
+		{
+			colors[i] = glm::vec3(texels[i][0], texels[i][1], texels[i][2]);
+			mean += colors[i];
+		}
+		mean /= 16.0f;
+		glm::mat3 covariance = glm::mat3(0.0f);
+		for (int i = 0; i < 16; i++)
+		{
+			glm::vec3 d = colors[i] - mean;
+			covariance += glm::mat3(d * d.x, d * d.y, d * d.z);
+		}
+		//Power iteration converges on the principal axis in a few steps for 3x3
+		glm::vec3 axis = glm::vec3(1.0f);
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 next = covariance * axis;
+			float length = glm::length(next);
+			if (length <= 0.0f) {
+				break;
+			}
+			axis = next / length;
+		}
+		axis = glm::normalize(axis);
+		float minT = 0.0f, maxT = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = glm::dot(colors[i] - mean, axis);
+			minT = glm::min(minT, t);
+			maxT = glm::max(maxT, t);
+		}
+		uint16_t color0 = packRGB565(mean + axis * maxT);
+		uint16_t color1 = packRGB565(mean + axis * minT);
+		if (color0 < color1) {
+			uint16_t temp = color0;
+			color0 = color1;
+			color1 = temp;
+		}
+		uint32_t indices = 0;
+		//Equal endpoints would select 3 color mode, where index 3 is transparent; index 0 everywhere is exact
+		if (color0 != color1) {
+			glm::vec3 palette[4];
+			palette[0] = unpackRGB565(color0);
+			palette[1] = unpackRGB565(color1);
+			palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+			palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				float bestDistance = FLT_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					glm::vec3 d = colors[i] - palette[p];
+					float distance = glm::dot(d, d);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= best << (i * 2);
+			}
+		}
+		out[0] = color0 & 0xFF;
+		out[1] = color0 >> 8;
+		out[2] = color1 & 0xFF;
+		out[3] = color1 >> 8;
+		for (int i = 0; i < 4; i++)
+		{
+			out[4 + i] = (indices >> (i * 8)) & 0xFF;
+		}
+	}
+
+	/// <summary>
+	/// BC4 block for one channel (BC3 alpha, each half of BC5). Uses the 8 value mode between the block's min and max.
+	/// </summary>
+	static void encodeChannelBlock(const unsigned char texels[16][4], int channel, unsigned char* out) {
+		int maxValue = 0, minValue = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			maxValue = glm::max(maxValue, (int)texels[i][channel]);
+			minValue = glm::min(minValue, (int)texels[i][channel]);
+		}
+		out[0] = (unsigned char)maxValue;
+		out[1] = (unsigned char)minValue;
+		uint64_t indices = 0;
+		if (maxValue != minValue) {
+			int palette[8];
+			palette[0] = maxValue;
+			palette[1] = minValue;
+			for (int k = 2; k < 8; k++)
+			{
+				palette[k] = ((8 - k) * maxValue + (k - 1) * minValue) / 7;
+			}
+			for (int i = 0; i < 16; i++)
+			{
+				uint64_t best = 0;
+				int bestDistance = 256;
+				for (int p = 0; p < 8; p++)
+				{
+					int distance = glm::abs((int)texels[i][channel] - palette[p]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= best << (i * 3);
+			}
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			out[2 + i] = (indices >> (i * 8)) & 0xFF;
+		}
+	}
+
+	static void encodeLevel(const unsigned char* rgba, unsigned int width, unsigned int height, BlockCompression format, unsigned char* out) {
+		const unsigned int blocksX = (width + 3) / 4;
+		const unsigned int blocksY = (height + 3) / 4;
+		const size_t blockSize = getBlockSize(format);
+		ew::getWorkerPool().parallelFor(blocksY, [&](size_t by) {
+			unsigned char texels[16][4];
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				//Edge blocks repeat the last row/column
+				for (unsigned int y = 0; y < 4; y++)
+				{
+					unsigned int py = glm::min((unsigned int)by * 4 + y, height - 1);
+					for (unsigned int x = 0; x < 4; x++)
+					{
+						unsigned int px = glm::min(bx * 4 + x, width - 1);
+						memcpy(texels[y * 4 + x], &rgba[((size_t)py * width + px) * 4], 4);
+					}
+				}
+				unsigned char* block = out + (by * blocksX + bx) * blockSize;
+				switch (format) {
+				case BlockCompression::BC1:
+					encodeColorBlock(texels, block);
+					break;
+				case BlockCompression::BC3:
+					encodeChannelBlock(texels, 3, block);
+					encodeColorBlock(texels, block + 8);
+					break;
+				case BlockCompression::BC5:
+					encodeChannelBlock(texels, 0, block);
+					encodeChannelBlock(texels, 1, block + 8);
+					break;
+				default:
+					break;
+				}
+			}
+		});
+	}
+
+	static float srgbToLinear(float c) {
+		return c <= 0.04045f ? c / 12.92f : glm::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float linearToSrgb(float c) {
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * glm::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	/// <summary>
+	/// 2x2 box filter. Odd edges reuse the last texel.
+	/// </summary>
+	static void downsample(const std::vector<unsigned char>& src, unsigned int width, unsigned int height, const TextureEncodeOptions& options, std::vector<unsigned char>* dst) {
+		const unsigned int dstWidth = width > 1 ? width / 2 : 1;
+		const unsigned int dstHeight = height > 1 ? height / 2 : 1;
+		dst->resize((size_t)dstWidth * dstHeight * 4);
+		for (unsigned int y = 0; y < dstHeight; y++)
+		{
+			for (unsigned int x = 0; x < dstWidth; x++)
+			{
+				glm::vec4 sum = glm::vec4(0.0f);
+				for (unsigned int i = 0; i < 4; i++)
+				{
+					unsigned int sx = glm::min(x * 2 + (i & 1), width - 1);
+					unsigned int sy = glm::min(y * 2 + (i >> 1), height - 1);
+					const unsigned char* texel = &src[((size_t)sy * width + sx) * 4];
+					glm::vec4 value = glm::vec4(texel[0], texel[1], texel[2], texel[3]) / 255.0f;
+					if (options.srgb) {
+						value = glm::vec4(srgbToLinear(value.r), srgbToLinear(value.g), srgbToLinear(value.b), value.a);
+					}
+					sum += value;
+				}
+				glm::vec4 result = sum * 0.25f;
+				if (options.srgb) {
+					result = glm::vec4(linearToSrgb(result.r), linearToSrgb(result.g), linearToSrgb(result.b), result.a);
+				}
+				if (options.normalMap) {
+					glm::vec3 normal = glm::vec3(result) * 2.0f - 1.0f;
+					float length = glm::length(normal);
+					if (length > 0.0f) {
+						result = glm::vec4(normal / length * 0.5f + 0.5f, result.a);
+					}
+				}
+				unsigned char* texel = &(*dst)[((size_t)y * dstWidth + x) * 4];
+				for (int c = 0; c < 4; c++)
+				{
+					texel[c] = (unsigned char)(glm::clamp(result[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Block compresses an RGBA8 image on the worker pool, optionally with a box filtered mip chain.
+	/// BC1 ignores alpha, BC5 keeps red and green only. BC7 is not encoded here.
+	/// </summary>
+	bool encodeTexture(const unsigned char* rgba, unsigned int width, unsigned int height, const TextureEncodeOptions& options, CompressedTextureData* result) {
+		if (options.format == BlockCompression::BC7) {
+			printf("BC7 encoding is not supported; use an external encoder and load the result\n");
+			return false;
+		}
+		if (width == 0 || height == 0) {
+			return false;
+		}
+		result->format = options.format;
+		result->srgb = options.srgb && options.format != BlockCompression::BC5;
+		result->levels.clear();
+		result->bytes.clear();
+
+		std::vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4);
+		std::vector<unsigned char> nextLevel;
+		while (true) {
+			CompressedMipLevel mip;
+			mip.width = width;
+			mip.height = height;
+			mip.offset = result->bytes.size();
+			mip.size = getCompressedLevelSize(options.format, width, height);
+			result->levels.push_back(mip);
+			result->bytes.resize(mip.offset + mip.size);
+			encodeLevel(level.data(), width, height, options.format, &result->bytes[mip.offset]);
+			if (!options.mipmap || (width == 1 && height == 1)) {
+				break;
+			}
+			downsample(level, width, height, options, &nextLevel);
+			level.swap(nextLevel);
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		return true;
+	}
+}
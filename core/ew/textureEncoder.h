@@ -0,0 +1,13 @@
+#pragma once
+#include "compressedTexture.h"
+
+namespace ew {
+	struct TextureEncodeOptions {
+		BlockCompression format = BlockCompression::BC1;
+		bool srgb = false; //Mark the result as sRGB and filter mips in linear space
+		bool mipmap = true; //Store a full mip chain down to 1x1
+		bool normalMap = false; //Renormalize xyz after each downsample
+	};
+
+	bool encodeTexture(const unsigned char* rgba, unsigned int width, unsigned int height, const TextureEncodeOptions& options, CompressedTextureData* result);
+}
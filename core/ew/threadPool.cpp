@@ -0,0 +1,120 @@
+#include "threadPool.h"
+#include <atomic>
+#include <memory>
+
+namespace ew {
+	/// <summary>
+	/// Starts worker threads
+	/// </summary>
+	/// <param name="numThreads">Number of workers. 0 uses one less than the hardware thread count, since the caller also works during parallelFor</param>
+	ThreadPool::ThreadPool(unsigned int numThreads)
+	{
+		if (numThreads == 0) {
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		m_threads.reserve(numThreads);
+		for (unsigned int i = 0; i < numThreads; i++)
+		{
+			m_threads.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_jobAvailable.notify_all();
+		for (size_t i = 0; i < m_threads.size(); i++)
+		{
+			m_threads[i].join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_jobAvailable.notify_one();
+	}
+
+	/// <summary>
+	/// Runs job(i) for every i in [0, count) across the workers and the calling thread. Blocks until all are done.
+	/// </summary>
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& job)
+	{
+		if (count == 0) {
+			return;
+		}
+		struct SharedState {
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> completed{ 0 };
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+		const std::function<void(size_t)>* jobPtr = &job;
+		//Workers hold the state alive; job is only dereferenced while completed < count, i.e. before we return
+		auto drain = [state, jobPtr, count]() {
+			size_t i;
+			while ((i = state->next.fetch_add(1)) < count) {
+				(*jobPtr)(i);
+				if (state->completed.fetch_add(1) + 1 == count) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->done.notify_all();
+				}
+			}
+		};
+		size_t numHelpers = count - 1 < m_threads.size() ? count - 1 : m_threads.size();
+		for (size_t i = 0; i < numHelpers; i++)
+		{
+			submit(drain);
+		}
+		drain();
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->done.wait(lock, [&]() { return state->completed.load() == count; });
+	}
+
+	/// <summary>
+	/// Blocks until the queue is empty and no worker is running a job
+	/// </summary>
+	void ThreadPool::waitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this]() { return m_jobs.empty() && m_numBusy == 0; });
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+				if (m_stopping && m_jobs.empty()) {
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+				m_numBusy++;
+			}
+			job();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_numBusy--;
+				if (m_numBusy == 0 && m_jobs.empty()) {
+					m_idle.notify_all();
+				}
+			}
+		}
+	}
+
+	ThreadPool& getWorkerPool() {
+		static ThreadPool pool;
+		return pool;
+	}
+}
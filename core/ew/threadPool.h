@@ -0,0 +1,37 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Fixed size pool of worker threads for CPU side asset work (mesh conversion, image decoding).
+	/// Jobs must not touch GL; hand results back to the GL thread instead.
+	/// </summary>
+	class ThreadPool {
+	public:
+		ThreadPool(unsigned int numThreads = 0);
+		~ThreadPool();
+		void submit(std::function<void()> job);
+		void parallelFor(size_t count, const std::function<void(size_t)>& job);
+		void waitIdle();
+		inline unsigned int getNumThreads()const { return (unsigned int)m_threads.size(); }
+	private:
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		void workerLoop();
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAvailable;
+		std::condition_variable m_idle;
+		unsigned int m_numBusy = 0;
+		bool m_stopping = false;
+	};
+
+	//Process wide pool sized to the hardware, created on first use
+	ThreadPool& getWorkerPool();
+}
@@ -0,0 +1,132 @@
+#include "vertexPacking.h"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	size_t getVertexSize(VertexFormat format) {
+		switch (format) {
+		case VertexFormat::PACKED:
+			return sizeof(PackedVertex);
+		case VertexFormat::PACKED_QUANTIZED:
+			return sizeof(QuantizedVertex);
+		default:
+			return sizeof(Vertex);
+		}
+	}
+
+	static float angleBetweenDegrees(const glm::vec3& a, const glm::vec3& b) {
+		float lengths = glm::length(a) * glm::length(b);
+		if (lengths <= 0.0f) {
+			return 0.0f;
+		}
+		return glm::degrees(acosf(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f)));
+	}
+
+	//Zero vectors (e.g. procGen meshes have no tangents) pack as zero rather than NaN
+	static uint32_t packDirection(const glm::vec3& v) {
+		float length = glm::length(v);
+		glm::vec3 n = length > 0.0f ? v / length : glm::vec3(0.0f);
+		return glm::packSnorm3x10_1x2(glm::vec4(n, 1.0f));
+	}
+
+	/// <summary>
+	/// Converts full vertices to a packed format
+	/// </summary>
+	/// <param name="vertices">Source vertices</param>
+	/// <param name="numVertices">Number of source vertices</param>
+	/// <param name="format">PACKED or PACKED_QUANTIZED</param>
+	/// <param name="boundsMin">Quantization bounds. Pass a shared box to give several meshes the same dequantization matrix</param>
+	/// <param name="boundsMax">Quantization bounds</param>
+	/// <param name="packed">Output</param>
+	/// <param name="report">Optional. Receives worst case decode error and sizes</param>
+	void packVertices(const Vertex* vertices, unsigned int numVertices, VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax, PackedVertexData* packed, VertexPackingReport* report) {
+		packed->format = format;
+		packed->numVertices = numVertices;
+		packed->bytes.resize(getVertexSize(format) * numVertices);
+		packed->dequantizeMatrix = glm::mat4(1.0f);
+		if (format == VertexFormat::FULL) {
+			memcpy(packed->bytes.data(), vertices, packed->bytes.size());
+			if (report) {
+				*report = VertexPackingReport();
+				report->bytesBefore = report->bytesAfter = packed->bytes.size();
+			}
+			return;
+		}
+
+		//Quantize into a cube so dequantization is a uniform scale and normal matrices are unaffected
+		glm::vec3 extents = boundsMax - boundsMin;
+		float scale = glm::max(glm::max(extents.x, extents.y), glm::max(extents.z, 1e-6f));
+		if (format == VertexFormat::PACKED_QUANTIZED) {
+			packed->dequantizeMatrix = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), glm::vec3(scale));
+		}
+
+		VertexPackingReport stats;
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			const Vertex& vertex = vertices[i];
+			uint32_t normal = packDirection(vertex.normal);
+			uint32_t tangent = packDirection(vertex.tangent);
+			uint32_t uv = glm::packHalf2x16(vertex.uv);
+			glm::vec3 decodedPos;
+			if (format == VertexFormat::PACKED) {
+				PackedVertex& out = ((PackedVertex*)packed->bytes.data())[i];
+				out.pos = vertex.pos;
+				out.normal = normal;
+				out.tangent = tangent;
+				out.uv = uv;
+				decodedPos = out.pos;
+			}
+			else {
+				QuantizedVertex& out = ((QuantizedVertex*)packed->bytes.data())[i];
+				glm::vec3 unit = glm::clamp((vertex.pos - boundsMin) / scale, 0.0f, 1.0f);
+				for (int c = 0; c < 3; c++)
+				{
+					out.pos[c] = (uint16_t)(unit[c] * 65535.0f + 0.5f);
+					decodedPos[c] = boundsMin[c] + (out.pos[c] / 65535.0f) * scale;
+				}
+				out.pos[3] = 0;
+				out.normal = normal;
+				out.tangent = tangent;
+				out.uv = uv;
+			}
+			glm::vec3 decodedNormal = glm::vec3(glm::unpackSnorm3x10_1x2(normal));
+			glm::vec3 decodedTangent = glm::vec3(glm::unpackSnorm3x10_1x2(tangent));
+			glm::vec2 decodedUV = glm::unpackHalf2x16(uv);
+			stats.maxPositionError = glm::max(stats.maxPositionError, glm::length(decodedPos - vertex.pos));
+			stats.maxNormalError = glm::max(stats.maxNormalError, angleBetweenDegrees(decodedNormal, vertex.normal));
+			stats.maxTangentError = glm::max(stats.maxTangentError, angleBetweenDegrees(decodedTangent, vertex.tangent));
+			stats.maxUVError = glm::max(stats.maxUVError, glm::length(decodedUV - vertex.uv));
+		}
+		if (report) {
+			stats.bytesBefore = sizeof(Vertex) * numVertices;
+			stats.bytesAfter = packed->bytes.size();
+			*report = stats;
+		}
+	}
+
+	/// <summary>
+	/// Converts a mesh's vertices to a packed format, quantizing against the mesh's own bounds
+	/// </summary>
+	void packVertices(const MeshData& meshData, VertexFormat format, PackedVertexData* packed, VertexPackingReport* report) {
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		if (!meshData.vertices.empty()) {
+			boundsMin = boundsMax = meshData.vertices[0].pos;
+		}
+		for (size_t i = 1; i < meshData.vertices.size(); i++)
+		{
+			boundsMin = glm::min(boundsMin, meshData.vertices[i].pos);
+			boundsMax = glm::max(boundsMax, meshData.vertices[i].pos);
+		}
+		packVertices(meshData.vertices.data(), (unsigned int)meshData.vertices.size(), format, boundsMin, boundsMax, packed, report);
+	}
+
+	void printVertexPackingReport(const char* name, const VertexPackingReport& report) {
+		printf("Packed %s: %zu -> %zu bytes (%.0f%%), max error pos %g, normal %.3f deg, tangent %.3f deg, uv %g\n", name,
+			report.bytesBefore, report.bytesAfter,
+			report.bytesBefore > 0 ? 100.0 * report.bytesAfter / report.bytesBefore : 0.0,
+			report.maxPositionError, report.maxNormalError, report.maxTangentError, report.maxUVError);
+	}
+}
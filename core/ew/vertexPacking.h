@@ -0,0 +1,46 @@
+#pragma once
+#include "mesh.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ew {
+	//Normal and tangent are snorm 10_10_10_2 (xyz + w), uv is half2. Shader inputs stay vec3/vec2.
+	//24 bytes, 55% of Vertex: the float position alone is 12, and 4 bytes is the least a normal, tangent or uv
+	//can take while the vertex fetch still decodes it with no shader changes. PACKED_QUANTIZED gets under half.
+	struct PackedVertex {
+		glm::vec3 pos;
+		uint32_t normal;
+		uint32_t tangent;
+		uint32_t uv;
+	};
+
+	//As PackedVertex, but position is unorm16 in the unit cube around the mesh bounds.
+	struct QuantizedVertex {
+		uint16_t pos[4]; //w is padding
+		uint32_t normal;
+		uint32_t tangent;
+		uint32_t uv;
+	};
+
+	struct PackedVertexData {
+		VertexFormat format = VertexFormat::PACKED;
+		std::vector<unsigned char> bytes;
+		unsigned int numVertices = 0;
+		glm::mat4 dequantizeMatrix = glm::mat4(1.0f); //Unit cube -> object space, for PACKED_QUANTIZED
+	};
+
+	//Worst case decode error, measured on the packed data
+	struct VertexPackingReport {
+		float maxPositionError = 0.0f; //Object space units
+		float maxNormalError = 0.0f; //Degrees
+		float maxTangentError = 0.0f; //Degrees
+		float maxUVError = 0.0f;
+		size_t bytesBefore = 0;
+		size_t bytesAfter = 0;
+	};
+
+	size_t getVertexSize(VertexFormat format);
+	void packVertices(const Vertex* vertices, unsigned int numVertices, VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax, PackedVertexData* packed, VertexPackingReport* report = nullptr);
+	void packVertices(const MeshData& meshData, VertexFormat format, PackedVertexData* packed, VertexPackingReport* report = nullptr);
+	void printVertexPackingReport(const char* name, const VertexPackingReport& report);
+}
@@ -2,6 +2,25 @@
 #include <iostream>
 
 namespace nb {
+	GBufferFormats getGBufferFormats(GBufferLayout layout) {
+		GBufferFormats formats;
+		if (layout == GBufferLayout::Compact) {
+			formats.position = 0; // Rebuilt from depth and the inverse view projection
+			formats.normal = GL_RG16; // Octahedral, remapped to 0-1
+			formats.albedo = GL_RGBA8; // Alpha holds a packed material parameter
+			formats.numColorBuffers = 2;
+		}
+		else {
+			formats.position = GL_RGB32F;
+			formats.normal = GL_RGB16F;
+			formats.albedo = GL_RGB16F;
+			formats.numColorBuffers = 3;
+		}
+		// Stencil is used to mask light volumes
+		formats.depth = GL_DEPTH24_STENCIL8;
+		return formats;
+	}
+
 	Framebuffer createFramebuffer(unsigned int width, unsigned int height, int colorFormat) {
 
 		// Create framebuffer object to return
@@ -30,7 +49,7 @@ namespace nb {
 		return fb;
 	}
 
-	Framebuffer createGBuffer(unsigned int width, unsigned int height) {
+	Framebuffer createGBuffer(unsigned int width, unsigned int height, GBufferLayout layout) {
 		Framebuffer gb;
 		gb.width = width;
 		gb.height = height;
@@ -38,17 +57,19 @@ namespace nb {
 		glCreateFramebuffers(1, &gb.fbo);
 		glBindFramebuffer(GL_FRAMEBUFFER, gb.fbo);
 
+		GBufferFormats gBufferFormats = getGBufferFormats(layout);
 		int formats[3] = {
-			GL_RGB32F, // 0 = world position
-			GL_RGB16F, // 1 = world normal
-			GL_RGB16F  // 2 = albedo
+			gBufferFormats.position, // world position, if stored
+			gBufferFormats.normal, // world normal
+			gBufferFormats.albedo // albedo
 		};
+		const int* colorFormats = gBufferFormats.position == 0 ? formats + 1 : formats;
 
-		// Create 3 color textures
-		for (size_t i = 0; i < 3; i++) {
+		// Create the color textures
+		for (size_t i = 0; i < gBufferFormats.numColorBuffers; i++) {
 			glGenTextures(1, &gb.colorBuffers[i]);
 			glBindTexture(GL_TEXTURE_2D, gb.colorBuffers[i]);
-			glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
+			glTexStorage2D(GL_TEXTURE_2D, 1, colorFormats[i], width, height);
 
 			// Clamp to border so we don't wrap when sampling for post processing
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -65,13 +86,15 @@ namespace nb {
 			GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2
 		};
 
-		glDrawBuffers(3, drawBuffers);
+		glDrawBuffers(gBufferFormats.numColorBuffers, drawBuffers);
 
-		// Create, bind, and attach depth buffer texture
+		// Create, bind, and attach depth buffer texture. Filtering must be nearest to sample it for position
 		glGenTextures(1, &gb.depthBuffer);
 		glBindTexture(GL_TEXTURE_2D, gb.depthBuffer);
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT16, width, height);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gb.depthBuffer, 0);
+		glTexStorage2D(GL_TEXTURE_2D, 1, gBufferFormats.depth, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gb.depthBuffer, 0);
 
 		GLenum gboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 		if (gboStatus != GL_FRAMEBUFFER_COMPLETE) {
@@ -10,6 +10,22 @@ namespace nb {
 		unsigned int width, height;
 	};
 
+	// How the Gbuffer stores a surface. Shaders decode both with gBuffer.glsl (COMPACT_GBUFFER 0 or 1)
+	enum class GBufferLayout {
+		Wide, // World position, normal, albedo: 28 bytes per pixel with depth
+		Compact // Octahedral normal, albedo + packed material; position rebuilt from depth: 12 bytes per pixel
+	};
+
+	// Texture formats of each target. position is 0 when the layout rebuilds it from depth
+	struct GBufferFormats {
+		int position;
+		int normal;
+		int albedo;
+		int depth;
+		unsigned int numColorBuffers;
+	};
+
+	GBufferFormats getGBufferFormats(GBufferLayout layout);
 	Framebuffer createFramebuffer(unsigned int width, unsigned int height, int colorFormat);
-	Framebuffer createGBuffer(unsigned int width, unsigned int height); // Creates Gbuffer w/3 color attachments
+	Framebuffer createGBuffer(unsigned int width, unsigned int height, GBufferLayout layout = GBufferLayout::Wide); // Color attachments in GBufferFormats order, skipping position when it is 0
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "lightBuffer.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace nb {
+	LightBuffer createLightBuffer(unsigned int capacity, unsigned int binding, LightBufferType type) {
+		LightBuffer lb;
+		lb.binding = binding;
+		lb.type = type;
+		lb.capacity = capacity;
+
+		// Clamp to what a uniform block can hold
+		if (type == LightBufferType::Uniform) {
+			int maxBlockSize = 0;
+			glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+			unsigned int maxLights = (unsigned int)(maxBlockSize - LIGHT_BUFFER_HEADER_SIZE) / sizeof(PointLight);
+			if (lb.capacity > maxLights) {
+				printf("Light buffer capacity %u exceeds the uniform block limit, clamping to %u\n", capacity, maxLights);
+				lb.capacity = maxLights;
+			}
+		}
+
+		size_t size = LIGHT_BUFFER_HEADER_SIZE + lb.capacity * sizeof(PointLight);
+		lb.staging.resize(size, 0);
+
+		// Immutable storage, rewritten with glNamedBufferSubData each frame
+		glCreateBuffers(1, &lb.buffer);
+		glNamedBufferStorage(lb.buffer, size, lb.staging.data(), GL_DYNAMIC_STORAGE_BIT);
+
+		return lb;
+	}
+
+	// Uploads the light count and the first count lights in a single call
+	void updateLightBuffer(LightBuffer* lightBuffer, const PointLight* lights, unsigned int count) {
+		if (count > lightBuffer->capacity) {
+			count = lightBuffer->capacity;
+		}
+		unsigned int header[LIGHT_BUFFER_HEADER_SIZE / sizeof(unsigned int)] = { count };
+		memcpy(lightBuffer->staging.data(), header, LIGHT_BUFFER_HEADER_SIZE);
+		memcpy(lightBuffer->staging.data() + LIGHT_BUFFER_HEADER_SIZE, lights, count * sizeof(PointLight));
+		glNamedBufferSubData(lightBuffer->buffer, 0, LIGHT_BUFFER_HEADER_SIZE + count * sizeof(PointLight), lightBuffer->staging.data());
+	}
+
+	void bindLightBuffer(const LightBuffer& lightBuffer) {
+		GLenum target = lightBuffer.type == LightBufferType::Uniform ? GL_UNIFORM_BUFFER : GL_SHADER_STORAGE_BUFFER;
+		glBindBufferBase(target, lightBuffer.binding, lightBuffer.buffer);
+	}
+
+	void deleteLightBuffer(LightBuffer* lightBuffer) {
+		glDeleteBuffers(1, &lightBuffer->buffer);
+		lightBuffer->buffer = 0;
+		lightBuffer->capacity = 0;
+		lightBuffer->staging.clear();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../ew/external/glad.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace nb {
+	// Matches the GLSL PointLight struct under both std140 and std430 (32 bytes, no padding)
+	struct PointLight {
+		glm::vec3 position;
+		float radius = 15;
+		glm::vec4 color = glm::vec4(1.0);
+	};
+	static_assert(sizeof(PointLight) == 32, "PointLight must match the std140/std430 layout");
+
+	// Uniform buffers are capped by GL_MAX_UNIFORM_BLOCK_SIZE, storage buffers are not
+	enum class LightBufferType {
+		Uniform,
+		Storage
+	};
+
+	// Header is a uint light count padded to 16 bytes, followed by the light array:
+	//   layout(std430, binding = N) readonly buffer PointLightBuffer { uint _NumPointLights; PointLight _PointLights[]; };
+	// Uniform buffers declare the array with a fixed size of at least capacity instead.
+	struct LightBuffer {
+		unsigned int buffer = 0;
+		unsigned int binding = 0;
+		unsigned int capacity = 0; // max lights
+		LightBufferType type = LightBufferType::Storage;
+		std::vector<unsigned char> staging; // header + lights, so each update is one upload
+	};
+
+	const unsigned int LIGHT_BUFFER_HEADER_SIZE = 16;
+
+	LightBuffer createLightBuffer(unsigned int capacity, unsigned int binding, LightBufferType type = LightBufferType::Storage);
+	void updateLightBuffer(LightBuffer* lightBuffer, const PointLight* lights, unsigned int count);
+	void bindLightBuffer(const LightBuffer& lightBuffer);
+	void deleteLightBuffer(LightBuffer* lightBuffer);
+}
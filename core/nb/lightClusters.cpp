@@ -0,0 +1,174 @@
+#include "lightClusters.h"
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+
+namespace nb {
+	LightClusters createLightClusters(unsigned int dimX, unsigned int dimY, unsigned int dimZ, unsigned int indexCapacity, unsigned int gridBinding, unsigned int indexBinding) {
+		LightClusters lc;
+		lc.dimX = dimX;
+		lc.dimY = dimY;
+		lc.dimZ = dimZ;
+		lc.indexCapacity = indexCapacity;
+		lc.gridBinding = gridBinding;
+		lc.indexBinding = indexBinding;
+
+		// Both are only written by the culling shader
+		unsigned int numClusters = dimX * dimY * dimZ;
+		glCreateBuffers(1, &lc.gridBuffer);
+		glNamedBufferStorage(lc.gridBuffer, LIGHT_CLUSTER_HEADER_SIZE + numClusters * sizeof(glm::uvec2), NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &lc.indexBuffer);
+		glNamedBufferStorage(lc.indexBuffer, indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_STORAGE_BIT);
+		return lc;
+	}
+
+	void bindLightClusters(const LightClusters& clusters) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, clusters.gridBinding, clusters.gridBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, clusters.indexBinding, clusters.indexBuffer);
+	}
+
+	// Uniforms read by clusters.glsl, for both the culling and the lighting shader
+	void setLightClusterUniforms(const ew::Shader& shader, const LightClusters& clusters, const ClusterView& view) {
+		shader.setInt("_ClusterDimX", clusters.dimX);
+		shader.setInt("_ClusterDimY", clusters.dimY);
+		shader.setInt("_ClusterDimZ", clusters.dimZ);
+		shader.setFloat("_ClusterNear", view.nearPlane);
+		shader.setFloat("_ClusterFar", view.farPlane);
+		shader.setMat4("_ClusterView", view.view);
+		shader.setMat4("_ClusterInverseProjection", glm::inverse(view.projection));
+	}
+
+	// Rebuilds every cluster's light list from the lights currently in the light buffer
+	void cullLightClusters(const LightClusters& clusters, const ew::Shader& cullShader, const LightBuffer& lights, const ClusterView& view) {
+		unsigned int zero = 0;
+		glClearNamedBufferSubData(clusters.gridBuffer, GL_R32UI, 0, sizeof(unsigned int), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		bindLightBuffer(lights);
+		bindLightClusters(clusters);
+		cullShader.use();
+		setLightClusterUniforms(cullShader, clusters, view);
+		cullShader.setInt("_ClusterIndexCapacity", clusters.indexCapacity);
+		unsigned int numClusters = clusters.dimX * clusters.dimY * clusters.dimZ;
+		cullShader.dispatch((numClusters + CLUSTER_CULL_GROUP_SIZE - 1) / CLUSTER_CULL_GROUP_SIZE);
+		// Lighting reads the lists as storage buffers
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	void deleteLightClusters(LightClusters* clusters) {
+		glDeleteBuffers(1, &clusters->gridBuffer);
+		glDeleteBuffers(1, &clusters->indexBuffer);
+		clusters->gridBuffer = clusters->indexBuffer = 0;
+	}
+
+	static float getSliceDepth(const LightClusters& clusters, const ClusterView& view, unsigned int slice) {
+		if (slice == 0) {
+			return 0.0f;
+		}
+		return view.nearPlane * glm::pow(view.farPlane / view.nearPlane, (float)slice / clusters.dimZ);
+	}
+
+	// View space AABB of a cluster. Matches getClusterBounds in clusters.glsl
+	void getClusterBounds(const LightClusters& clusters, const ClusterView& view, unsigned int cluster, glm::vec3* boundsMin, glm::vec3* boundsMax) {
+		unsigned int x = cluster % clusters.dimX;
+		unsigned int y = (cluster / clusters.dimX) % clusters.dimY;
+		unsigned int z = cluster / (clusters.dimX * clusters.dimY);
+		glm::mat4 inverseProjection = glm::inverse(view.projection);
+		float depths[2] = { getSliceDepth(clusters, view, z), getSliceDepth(clusters, view, z + 1) };
+		*boundsMin = glm::vec3(1e30f);
+		*boundsMax = glm::vec3(-1e30f);
+		for (int corner = 0; corner < 4; corner++) {
+			glm::vec2 ndc = glm::vec2((float)(x + (corner & 1)) / clusters.dimX, (float)(y + (corner >> 1)) / clusters.dimY) * 2.0f - 1.0f;
+			// Ray through the tile corner, scaled to unit view depth
+			glm::vec4 point = inverseProjection * glm::vec4(ndc, -1.0f, 1.0f);
+			glm::vec3 ray = glm::vec3(point) / point.w;
+			ray /= -ray.z;
+			for (int d = 0; d < 2; d++) {
+				*boundsMin = glm::min(*boundsMin, ray * depths[d]);
+				*boundsMax = glm::max(*boundsMax, ray * depths[d]);
+			}
+		}
+	}
+
+	static bool sphereIntersectsBounds(const glm::vec3& center, float radius, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 closest = glm::clamp(center, boundsMin, boundsMax);
+		glm::vec3 d = closest - center;
+		return glm::dot(d, d) <= radius * radius;
+	}
+
+	// Same output as lightCulling.comp, except that offsets are assigned in cluster order instead of by atomics
+	void cullLightClustersCPU(const LightClusters& clusters, const ClusterView& view, const PointLight* lights, unsigned int numLights,
+		std::vector<glm::uvec2>* grid, std::vector<unsigned int>* indices) {
+		unsigned int numClusters = clusters.dimX * clusters.dimY * clusters.dimZ;
+		grid->assign(numClusters, glm::uvec2(0));
+		indices->clear();
+		std::vector<glm::vec3> viewPositions(numLights);
+		for (unsigned int i = 0; i < numLights; i++) {
+			viewPositions[i] = glm::vec3(view.view * glm::vec4(lights[i].position, 1.0f));
+		}
+		for (unsigned int c = 0; c < numClusters; c++) {
+			glm::vec3 boundsMin, boundsMax;
+			getClusterBounds(clusters, view, c, &boundsMin, &boundsMax);
+			unsigned int offset = (unsigned int)indices->size();
+			unsigned int count = 0;
+			for (unsigned int i = 0; i < numLights && count < CLUSTER_MAX_LIGHTS; i++) {
+				if (sphereIntersectsBounds(viewPositions[i], lights[i].radius, boundsMin, boundsMax)) {
+					if (offset + count >= clusters.indexCapacity) {
+						break;
+					}
+					indices->push_back(i);
+					count++;
+				}
+			}
+			(*grid)[c] = glm::uvec2(offset, count);
+		}
+	}
+
+	// Reads the GPU lists back and compares each cluster against the CPU reference. Stalls; for debugging only.
+	bool validateLightClusters(const LightClusters& clusters, const ClusterView& view, const PointLight* lights, unsigned int numLights) {
+		std::vector<glm::uvec2> cpuGrid;
+		std::vector<unsigned int> cpuIndices;
+		cullLightClustersCPU(clusters, view, lights, numLights, &cpuGrid, &cpuIndices);
+
+		unsigned int numClusters = clusters.dimX * clusters.dimY * clusters.dimZ;
+		unsigned int totalIndices = 0;
+		std::vector<glm::uvec2> gpuGrid(numClusters);
+		std::vector<unsigned int> gpuIndices(clusters.indexCapacity);
+		glFinish();
+		glGetNamedBufferSubData(clusters.gridBuffer, 0, sizeof(unsigned int), &totalIndices);
+		glGetNamedBufferSubData(clusters.gridBuffer, LIGHT_CLUSTER_HEADER_SIZE, numClusters * sizeof(glm::uvec2), gpuGrid.data());
+		glGetNamedBufferSubData(clusters.indexBuffer, 0, clusters.indexCapacity * sizeof(unsigned int), gpuIndices.data());
+
+		unsigned int numMismatched = 0;
+		std::vector<unsigned int> cpuList, gpuList, differing;
+		for (unsigned int c = 0; c < numClusters; c++) {
+			glm::uvec2 cpu = cpuGrid[c], gpu = gpuGrid[c];
+			if (gpu.x + gpu.y > clusters.indexCapacity) {
+				numMismatched++;
+				continue;
+			}
+			cpuList.assign(cpuIndices.begin() + cpu.x, cpuIndices.begin() + cpu.x + cpu.y);
+			gpuList.assign(gpuIndices.begin() + gpu.x, gpuIndices.begin() + gpu.x + gpu.y);
+			if (cpuList == gpuList) {
+				continue;
+			}
+			// Both lists are in ascending light order. Lights only one side found must graze the cluster,
+			// where CPU and GPU float math may round differently
+			differing.clear();
+			std::set_symmetric_difference(cpuList.begin(), cpuList.end(), gpuList.begin(), gpuList.end(), std::back_inserter(differing));
+			glm::vec3 boundsMin, boundsMax;
+			getClusterBounds(clusters, view, c, &boundsMin, &boundsMax);
+			for (unsigned int index : differing) {
+				glm::vec3 center = glm::vec3(view.view * glm::vec4(lights[index].position, 1.0f));
+				float radius = lights[index].radius;
+				bool grazing = sphereIntersectsBounds(center, radius + 1e-3f, boundsMin, boundsMax)
+					&& !sphereIntersectsBounds(center, glm::max(radius - 1e-3f, 0.0f), boundsMin, boundsMax);
+				if (!grazing) {
+					numMismatched++;
+					break;
+				}
+			}
+		}
+		printf("Light cluster validation: %u clusters, %u/%u indices (CPU %zu), %u mismatched\n",
+			numClusters, totalIndices, clusters.indexCapacity, cpuIndices.size(), numMismatched);
+		return numMismatched == 0;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../ew/external/glad.h"
+#include "../ew/shader.h"
+#include "lightBuffer.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace nb {
+	// Lights past this many in one cluster are dropped
+	const unsigned int CLUSTER_MAX_LIGHTS = 256;
+	// Work group size of lightCulling.comp, one invocation per cluster
+	const unsigned int CLUSTER_CULL_GROUP_SIZE = 64;
+	// Grid buffer header: total index count, padded so the uvec2 array starts on 16 bytes
+	const unsigned int LIGHT_CLUSTER_HEADER_SIZE = 16;
+
+	// The view frustum split into dimX x dimY screen tiles and dimZ depth slices.
+	// Slices are spaced exponentially from nearPlane to farPlane, so clusters stay roughly cube shaped.
+	// GLSL side (clusters.glsl):
+	//   layout(std430, binding = gridBinding) buffer ClusterGrid { uint _TotalClusterIndices; uint _ClusterPadding[3]; uvec2 _Clusters[]; }; // {offset, count}
+	//   layout(std430, binding = indexBinding) buffer ClusterIndices { uint _ClusterLightIndices[]; };
+	struct LightClusters {
+		unsigned int gridBuffer = 0;
+		unsigned int indexBuffer = 0;
+		unsigned int dimX = 16, dimY = 9, dimZ = 24;
+		unsigned int indexCapacity = 0; // Total light indices over all clusters; clusters past it come out empty
+		unsigned int gridBinding = 3;
+		unsigned int indexBinding = 4;
+	};
+
+	// What culling and shading need to agree on
+	struct ClusterView {
+		glm::mat4 view;
+		glm::mat4 projection; // Perspective
+		float nearPlane; // Start of the first slice. Closer pixels fall in slice 0
+		float farPlane;
+	};
+
+	LightClusters createLightClusters(unsigned int dimX, unsigned int dimY, unsigned int dimZ, unsigned int indexCapacity, unsigned int gridBinding = 3, unsigned int indexBinding = 4);
+	void cullLightClusters(const LightClusters& clusters, const ew::Shader& cullShader, const LightBuffer& lights, const ClusterView& view);
+	void bindLightClusters(const LightClusters& clusters);
+	void setLightClusterUniforms(const ew::Shader& shader, const LightClusters& clusters, const ClusterView& view);
+	void deleteLightClusters(LightClusters* clusters);
+
+	// Reference implementation of lightCulling.comp with the same bounds and tests
+	void getClusterBounds(const LightClusters& clusters, const ClusterView& view, unsigned int cluster, glm::vec3* boundsMin, glm::vec3* boundsMax);
+	void cullLightClustersCPU(const LightClusters& clusters, const ClusterView& view, const PointLight* lights, unsigned int numLights,
+		std::vector<glm::uvec2>* grid, std::vector<unsigned int>* indices);
+	bool validateLightClusters(const LightClusters& clusters, const ClusterView& view, const PointLight* lights, unsigned int numLights);
+}
@@ -0,0 +1,353 @@
+#include "renderGraph.h"
+#include "../ew/glState.h"
+#include <stdio.h>
+
+namespace nb {
+	static bool isDepthFormat(GLenum format) {
+		return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32
+			|| format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	static bool isStencilFormat(GLenum format) {
+		return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	// Only used for the memory stats, so unknown formats are counted as 4 bytes
+	static size_t getBytesPerTexel(GLenum format) {
+		switch (format) {
+		case GL_R8: return 1;
+		case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+		case GL_RGB8: case GL_SRGB8: case GL_DEPTH_COMPONENT24: return 3;
+		case GL_RG16F: case GL_RG16: case GL_RGBA8: case GL_R32F: case GL_RGB10_A2: case GL_R11F_G11F_B10F: case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT32F: return 4;
+		case GL_RGB16F: return 6;
+		case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+		case GL_RGB32F: return 12;
+		case GL_RGBA32F: return 16;
+		default: return 4;
+		}
+	}
+
+	static size_t getTextureBytes(const RenderTextureDesc& desc) {
+		return (size_t)desc.width * desc.height * getBytesPerTexel(desc.format);
+	}
+
+	static bool isSameDesc(const RenderTextureDesc& a, const RenderTextureDesc& b) {
+		return a.width == b.width && a.height == b.height && a.format == b.format && a.filter == b.filter && a.wrap == b.wrap;
+	}
+
+	RenderResource RenderPassBuilder::create(const char* name, const RenderTextureDesc& desc) {
+		RenderGraph::Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		m_graph->m_resources.push_back(resource);
+		return write((RenderResource)m_graph->m_resources.size() - 1);
+	}
+
+	RenderResource RenderPassBuilder::read(RenderResource resource) {
+		m_graph->m_passes[m_pass].reads.push_back(resource);
+		return resource;
+	}
+
+	RenderResource RenderPassBuilder::write(RenderResource resource) {
+		m_graph->m_passes[m_pass].writes.push_back(resource);
+		m_graph->m_resources[resource].writers.push_back(m_pass);
+		return resource;
+	}
+
+	void RenderPassBuilder::setSideEffect() {
+		m_graph->m_passes[m_pass].sideEffect = true;
+	}
+
+	RenderGraph::~RenderGraph() {
+		release();
+	}
+
+	RenderResource RenderGraph::importTexture(const char* name, unsigned int texture, const RenderTextureDesc& desc) {
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		resource.texture = texture;
+		resource.imported = true;
+		m_resources.push_back(resource);
+		return (RenderResource)m_resources.size() - 1;
+	}
+
+	RenderResource RenderGraph::importBackbuffer(unsigned int width, unsigned int height) {
+		RenderTextureDesc desc;
+		desc.width = width;
+		desc.height = height;
+		RenderResource resource = importTexture("Backbuffer", 0, desc);
+		m_resources[resource].backbuffer = true;
+		return resource;
+	}
+
+	void RenderGraph::addPass(const char* name, SetupFunction setup, ExecuteFunction execute) {
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		m_passes.push_back(pass);
+		RenderPassBuilder builder(this, (unsigned int)m_passes.size() - 1);
+		setup(builder);
+	}
+
+	unsigned int RenderGraph::getTexture(RenderResource resource) const {
+		if (resource >= m_resources.size()) {
+			return 0;
+		}
+		return m_resources[resource].texture;
+	}
+
+	void RenderGraph::compile() {
+		// Roots are passes with visible results. Walking backwards, a needed pass makes every
+		// earlier writer of what it reads needed too; anything left over is culled
+		for (size_t i = m_passes.size(); i-- > 0;) {
+			Pass& pass = m_passes[i];
+			if (!pass.needed) {
+				pass.needed = pass.sideEffect;
+				for (RenderResource resource : pass.writes) {
+					pass.needed |= m_resources[resource].imported;
+				}
+			}
+			if (!pass.needed) {
+				continue;
+			}
+			for (RenderResource resource : pass.reads) {
+				for (unsigned int writer : m_resources[resource].writers) {
+					if (writer < i) {
+						m_passes[writer].needed = true;
+					}
+				}
+			}
+		}
+
+		// Lifetimes over the surviving passes decide when transients enter and leave the pool
+		for (Resource& resource : m_resources) {
+			resource.firstUse = 0xFFFFFFFF;
+			resource.lastUse = 0;
+		}
+		m_numCulledPasses = 0;
+		for (unsigned int i = 0; i < m_passes.size(); i++) {
+			if (!m_passes[i].needed) {
+				m_numCulledPasses++;
+				continue;
+			}
+			for (int access = 0; access < 2; access++) {
+				for (RenderResource id : access == 0 ? m_passes[i].reads : m_passes[i].writes) {
+					Resource& resource = m_resources[id];
+					resource.firstUse = resource.firstUse == 0xFFFFFFFF ? i : resource.firstUse;
+					resource.lastUse = i;
+				}
+			}
+		}
+	}
+
+	unsigned int RenderGraph::acquireTexture(const RenderTextureDesc& desc) {
+		for (PooledTexture& pooled : m_pool) {
+			if (!pooled.inUse && isSameDesc(pooled.desc, desc)) {
+				pooled.inUse = true;
+				pooled.lastUsedFrame = m_frame;
+				return pooled.texture;
+			}
+		}
+		PooledTexture pooled;
+		glCreateTextures(GL_TEXTURE_2D, 1, &pooled.texture);
+		glTextureStorage2D(pooled.texture, 1, desc.format, desc.width, desc.height);
+		glTextureParameteri(pooled.texture, GL_TEXTURE_MIN_FILTER, desc.filter);
+		glTextureParameteri(pooled.texture, GL_TEXTURE_MAG_FILTER, desc.filter);
+		glTextureParameteri(pooled.texture, GL_TEXTURE_WRAP_S, desc.wrap);
+		glTextureParameteri(pooled.texture, GL_TEXTURE_WRAP_T, desc.wrap);
+		pooled.desc = desc;
+		pooled.inUse = true;
+		pooled.lastUsedFrame = m_frame;
+		m_pool.push_back(pooled);
+		m_allocatedBytes += getTextureBytes(desc);
+		return pooled.texture;
+	}
+
+	void RenderGraph::releaseTexture(unsigned int texture) {
+		for (PooledTexture& pooled : m_pool) {
+			if (pooled.texture == texture) {
+				pooled.inUse = false;
+				return;
+			}
+		}
+	}
+
+	unsigned int RenderGraph::getFramebuffer(const Pass& pass, unsigned int* width, unsigned int* height) {
+		// Color attachments follow the pass's write order, so shader output locations match declaration order
+		std::vector<unsigned int> colors;
+		unsigned int depth = 0;
+		GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+		for (RenderResource id : pass.writes) {
+			const Resource& resource = m_resources[id];
+			*width = resource.desc.width;
+			*height = resource.desc.height;
+			if (resource.backbuffer) {
+				return 0;
+			}
+			if (isDepthFormat(resource.desc.format)) {
+				depth = resource.texture;
+				depthAttachment = isStencilFormat(resource.desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			}
+			else {
+				colors.push_back(resource.texture);
+			}
+		}
+		std::vector<unsigned int> key = colors;
+		key.push_back(depth);
+		auto it = m_framebuffers.find(key);
+		if (it != m_framebuffers.end()) {
+			return it->second;
+		}
+
+		unsigned int fbo;
+		glCreateFramebuffers(1, &fbo);
+		std::vector<GLenum> drawBuffers;
+		for (size_t i = 0; i < colors.size(); i++) {
+			glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0 + (GLenum)i, colors[i], 0);
+			drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+		}
+		if (depth != 0) {
+			glNamedFramebufferTexture(fbo, depthAttachment, depth, 0);
+		}
+		if (drawBuffers.empty()) {
+			glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+			glNamedFramebufferReadBuffer(fbo, GL_NONE);
+		}
+		else {
+			glNamedFramebufferDrawBuffers(fbo, (GLsizei)drawBuffers.size(), drawBuffers.data());
+		}
+		GLenum status = glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Render graph framebuffer for pass %s incomplete: %d\n", pass.name.c_str(), status);
+		}
+		m_framebuffers[key] = fbo;
+		return fbo;
+	}
+
+	// Frees pool textures nothing has used for a few frames (e.g. after a resize), and the framebuffers built on them
+	void RenderGraph::trimPool() {
+		for (size_t i = 0; i < m_pool.size();) {
+			PooledTexture& pooled = m_pool[i];
+			if (pooled.inUse || m_frame - pooled.lastUsedFrame < NUM_TIMING_FRAMES) {
+				i++;
+				continue;
+			}
+			for (auto it = m_framebuffers.begin(); it != m_framebuffers.end();) {
+				bool attached = false;
+				for (unsigned int texture : it->first) {
+					attached |= texture == pooled.texture;
+				}
+				if (attached) {
+					glDeleteFramebuffers(1, &it->second);
+					it = m_framebuffers.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+			glDeleteTextures(1, &pooled.texture);
+			m_allocatedBytes -= getTextureBytes(pooled.desc);
+			m_pool.erase(m_pool.begin() + i);
+			ew::invalidateGLState();
+		}
+	}
+
+	void RenderGraph::readTimings(TimingQueries* frame) {
+		if (frame->numIssued == 0) {
+			return;
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(frame->queries[frame->numIssued - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return;
+		}
+		m_timings.resize(frame->numIssued);
+		for (unsigned int i = 0; i < frame->numIssued; i++) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &elapsed);
+			m_timings[i].name = frame->names[i];
+			m_timings[i].gpuMs = (float)(elapsed / 1000000.0);
+		}
+		frame->numIssued = 0;
+	}
+
+	void RenderGraph::execute() {
+		compile();
+
+		// This slot's queries were issued NUM_TIMING_FRAMES frames ago
+		TimingQueries& timing = m_timingFrames[m_frame % NUM_TIMING_FRAMES];
+		readTimings(&timing);
+		timing.numIssued = 0;
+		timing.names.clear();
+
+		m_transientBytes = 0;
+		for (unsigned int i = 0; i < m_passes.size(); i++) {
+			Pass& pass = m_passes[i];
+			if (!pass.needed) {
+				continue;
+			}
+			for (RenderResource id : pass.writes) {
+				Resource& resource = m_resources[id];
+				if (!resource.imported && resource.firstUse == i) {
+					resource.texture = acquireTexture(resource.desc);
+					m_transientBytes += getTextureBytes(resource.desc);
+				}
+			}
+
+			if (!pass.writes.empty()) {
+				unsigned int width = 0, height = 0;
+				ew::bindFramebuffer(GL_FRAMEBUFFER, getFramebuffer(pass, &width, &height));
+				glViewport(0, 0, width, height);
+			}
+
+			if (timing.numIssued == timing.queries.size()) {
+				unsigned int query;
+				glGenQueries(1, &query);
+				timing.queries.push_back(query);
+			}
+			glBeginQuery(GL_TIME_ELAPSED, timing.queries[timing.numIssued]);
+			pass.execute(*this);
+			glEndQuery(GL_TIME_ELAPSED);
+			timing.names.push_back(pass.name);
+			timing.numIssued++;
+
+			// Transients whose last reader just ran go back to the pool for later passes to alias
+			for (int access = 0; access < 2; access++) {
+				for (RenderResource id : access == 0 ? pass.reads : pass.writes) {
+					Resource& resource = m_resources[id];
+					if (!resource.imported && resource.lastUse == i && resource.texture != 0) {
+						releaseTexture(resource.texture);
+						resource.texture = 0;
+					}
+				}
+			}
+		}
+
+		m_passes.clear();
+		m_resources.clear();
+		trimPool();
+		m_frame++;
+	}
+
+	void RenderGraph::release() {
+		for (auto& it : m_framebuffers) {
+			glDeleteFramebuffers(1, &it.second);
+		}
+		m_framebuffers.clear();
+		for (PooledTexture& pooled : m_pool) {
+			glDeleteTextures(1, &pooled.texture);
+		}
+		m_pool.clear();
+		for (TimingQueries& frame : m_timingFrames) {
+			if (!frame.queries.empty()) {
+				glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+			}
+			frame.queries.clear();
+			frame.names.clear();
+			frame.numIssued = 0;
+		}
+		m_allocatedBytes = 0;
+		ew::invalidateGLState();
+	}
+}
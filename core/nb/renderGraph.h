@@ -0,0 +1,121 @@
+#pragma once
+
+#include "../ew/external/glad.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nb {
+	// Index of a texture declared in the current frame's graph
+	typedef unsigned int RenderResource;
+	const RenderResource RENDER_RESOURCE_NONE = 0xFFFFFFFF;
+
+	struct RenderTextureDesc {
+		unsigned int width = 0;
+		unsigned int height = 0;
+		GLenum format = GL_RGBA8; // Sized internal format. Depth formats become the depth attachment
+		GLenum filter = GL_NEAREST;
+		GLenum wrap = GL_CLAMP_TO_EDGE;
+	};
+
+	struct RenderPassTiming {
+		std::string name;
+		float gpuMs = 0.0f;
+	};
+
+	class RenderGraph;
+
+	// Handed to a pass's setup function to declare what the pass touches
+	class RenderPassBuilder {
+	public:
+		RenderResource create(const char* name, const RenderTextureDesc& desc);
+		RenderResource read(RenderResource resource);
+		RenderResource write(RenderResource resource);
+		void setSideEffect(); // Never culled, e.g. UI or readbacks
+	private:
+		friend class RenderGraph;
+		RenderPassBuilder(RenderGraph* graph, unsigned int pass) : m_graph(graph), m_pass(pass) {};
+		RenderGraph* m_graph;
+		unsigned int m_pass;
+	};
+
+	// A frame described as passes with declared reads and writes, rebuilt every frame:
+	//   graph.addPass("Lighting", [&](nb::RenderPassBuilder& builder) { ... }, [&](const nb::RenderGraph& graph) { ... });
+	//   graph.execute();
+	// Passes run in declaration order, which is always a valid order since a pass can only use resources declared before it.
+	// Passes whose writes nobody reads are culled. Transient textures come from a pool shared by every
+	// resource whose lifetime does not overlap, and the graph binds a framebuffer built from each pass's writes.
+	class RenderGraph {
+	public:
+		typedef std::function<void(RenderPassBuilder&)> SetupFunction;
+		typedef std::function<void(const RenderGraph&)> ExecuteFunction;
+
+		RenderGraph() {};
+		~RenderGraph();
+		RenderResource importTexture(const char* name, unsigned int texture, const RenderTextureDesc& desc);
+		RenderResource importBackbuffer(unsigned int width, unsigned int height);
+		void addPass(const char* name, SetupFunction setup, ExecuteFunction execute);
+		void execute();
+		unsigned int getTexture(RenderResource resource) const;
+		void release();
+
+		inline const std::vector<RenderPassTiming>& getPassTimings()const { return m_timings; }
+		inline unsigned int getNumCulledPasses()const { return m_numCulledPasses; }
+		inline size_t getTransientBytes()const { return m_transientBytes; } // Sum of every transient texture declared last frame
+		inline size_t getAllocatedBytes()const { return m_allocatedBytes; } // What the pool actually holds
+	private:
+		friend class RenderPassBuilder;
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		struct Resource {
+			std::string name;
+			RenderTextureDesc desc;
+			unsigned int texture = 0;
+			bool imported = false;
+			bool backbuffer = false;
+			std::vector<unsigned int> writers; // Pass indices in declaration order
+			unsigned int firstUse = 0;
+			unsigned int lastUse = 0;
+		};
+		struct Pass {
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<RenderResource> reads;
+			std::vector<RenderResource> writes;
+			bool sideEffect = false;
+			bool needed = false;
+		};
+		struct PooledTexture {
+			unsigned int texture;
+			RenderTextureDesc desc;
+			bool inUse;
+			unsigned int lastUsedFrame;
+		};
+		struct TimingQueries {
+			std::vector<unsigned int> queries;
+			std::vector<std::string> names;
+			unsigned int numIssued = 0;
+		};
+
+		void compile();
+		unsigned int acquireTexture(const RenderTextureDesc& desc);
+		void releaseTexture(unsigned int texture);
+		unsigned int getFramebuffer(const Pass& pass, unsigned int* width, unsigned int* height);
+		void trimPool();
+		void readTimings(TimingQueries* frame);
+
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		std::vector<PooledTexture> m_pool;
+		std::map<std::vector<unsigned int>, unsigned int> m_framebuffers; // Attachment textures -> FBO
+		static const unsigned int NUM_TIMING_FRAMES = 3; // Results are read this many frames later, so queries never stall
+		TimingQueries m_timingFrames[NUM_TIMING_FRAMES];
+		std::vector<RenderPassTiming> m_timings;
+		unsigned int m_frame = 0;
+		unsigned int m_numCulledPasses = 0;
+		size_t m_transientBytes = 0;
+		size_t m_allocatedBytes = 0;
+	};
+}
@@ -1,4 +1,7 @@
 #include "shadowmap.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <string>
 
 namespace nb {
 	ShadowMap createShadowMap(unsigned int width, unsigned int height) {
@@ -35,4 +38,172 @@ namespace nb {
 
 		return sm;
 	}
-}
\ No newline at end of file
+
+	CascadedShadowMap createCascadedShadowMap(unsigned int resolution, unsigned int numCascades) {
+		CascadedShadowMap csm;
+		csm.resolution = resolution;
+		csm.numCascades = glm::clamp(numCascades, 1u, MAX_SHADOW_CASCADES);
+
+		// Storage for every cascade up front, so the count can change without reallocating
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &csm.depthTexture);
+		glTextureStorage3D(csm.depthTexture, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, MAX_SHADOW_CASCADES);
+		glTextureParameteri(csm.depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(csm.depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(csm.depthTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTextureParameteri(csm.depthTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		float borderColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTextureParameterfv(csm.depthTexture, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+		glGenTextures(MAX_SHADOW_CASCADES, csm.layerViews);
+		for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++) {
+			glTextureView(csm.layerViews[i], GL_TEXTURE_2D, csm.depthTexture, GL_DEPTH_COMPONENT32F, 0, 1, i, 1);
+		}
+
+		// Attaching the whole array makes the framebuffer layered
+		glCreateFramebuffers(1, &csm.fbo);
+		glNamedFramebufferTexture(csm.fbo, GL_DEPTH_ATTACHMENT, csm.depthTexture, 0);
+		glNamedFramebufferDrawBuffer(csm.fbo, GL_NONE);
+		glNamedFramebufferReadBuffer(csm.fbo, GL_NONE);
+		return csm;
+	}
+
+	// Corners of the camera frustum between two view depths, in world space
+	static void getFrustumSliceCorners(const ew::Camera& camera, const glm::mat4& inverseView, float nearDepth, float farDepth, glm::vec3* corners) {
+		float tanHalfFov = glm::tan(glm::radians(camera.fov) * 0.5f);
+		float depths[2] = { nearDepth, farDepth };
+		for (int d = 0; d < 2; d++) {
+			float halfHeight = depths[d] * tanHalfFov;
+			float halfWidth = halfHeight * camera.aspectRatio;
+			for (int corner = 0; corner < 4; corner++) {
+				glm::vec3 viewCorner = glm::vec3((corner & 1) ? halfWidth : -halfWidth, (corner & 2) ? halfHeight : -halfHeight, -depths[d]);
+				corners[d * 4 + corner] = glm::vec3(inverseView * glm::vec4(viewCorner, 1.0f));
+			}
+		}
+	}
+
+	// Splits the camera frustum out to shadowDistance and fits a light space box around each slice.
+	// Each box is the square around the slice's bounding sphere, so its size does not change as the camera turns,
+	// and its center snaps to whole texels, so shadow edges stay put as the camera moves.
+	void updateShadowCascades(CascadedShadowMap* shadowMap, const ew::Camera& camera, const glm::vec3& lightDirection, float shadowDistance) {
+		float nearPlane = camera.nearPlane;
+		float farPlane = glm::min(camera.farPlane, shadowDistance);
+		unsigned int numCascades = shadowMap->numCascades;
+		for (unsigned int i = 0; i < numCascades; i++) {
+			// Practical split scheme: a blend of logarithmic and uniform splits
+			float t = (float)(i + 1) / numCascades;
+			float logSplit = nearPlane * glm::pow(farPlane / nearPlane, t);
+			float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+			shadowMap->splits[i] = glm::mix(uniformSplit, logSplit, shadowMap->splitLambda);
+		}
+
+		glm::vec3 direction = glm::normalize(lightDirection);
+		glm::vec3 up = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		// One light orientation for every cascade; only the ortho bounds differ
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+		glm::mat4 inverseView = glm::inverse(camera.viewMatrix());
+		shadowMap->cameraView = camera.viewMatrix();
+
+		glm::vec3 corners[8];
+		glm::vec3 boundsMin = glm::vec3(1e30f), boundsMax = glm::vec3(-1e30f);
+		for (unsigned int i = 0; i < numCascades; i++) {
+			float sliceNear = i == 0 ? nearPlane : shadowMap->splits[i - 1];
+			getFrustumSliceCorners(camera, inverseView, sliceNear, shadowMap->splits[i], corners);
+
+			glm::vec3 center = glm::vec3(0.0f);
+			for (int c = 0; c < 8; c++) {
+				center += corners[c];
+				boundsMin = glm::min(boundsMin, corners[c]);
+				boundsMax = glm::max(boundsMax, corners[c]);
+			}
+			center /= 8.0f;
+			float radius = 0.0f;
+			for (int c = 0; c < 8; c++) {
+				radius = glm::max(radius, glm::length(corners[c] - center));
+			}
+			// Rounded up so float noise in the corners cannot change the texel size
+			radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+			// Snap the center to the texel grid in light space, and its depth to a coarser step.
+			// Small camera moves then leave the matrices bit for bit equal, which is what keeps the static shadow cache valid
+			float texelSize = 2.0f * radius / shadowMap->resolution;
+			float depthStep = radius * 0.25f;
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+			lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+			lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+			lightCenter.z = glm::floor(lightCenter.z / depthStep) * depthStep;
+
+			// The light looks down -z. Depth spans the sphere plus the caster margin toward the light,
+			// widened by one step on that side since snapping can move the range up to a step away from it
+			glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+				-lightCenter.z - radius - depthStep - shadowMap->casterMargin, -lightCenter.z + radius);
+			shadowMap->viewProjections[i] = projection * lightView;
+		}
+
+		shadowMap->boundsCenter = (boundsMin + boundsMax) * 0.5f;
+		shadowMap->boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+	}
+
+	// Uniforms declared in shadowCascades.glsl, read by shadows.glsl and shadowCascades.geom
+	void setShadowCascadeUniforms(const ew::Shader& shader, const CascadedShadowMap& shadowMap) {
+		shader.setInt("_NumCascades", shadowMap.numCascades);
+		shader.setMat4("_CascadeCameraView", shadowMap.cameraView);
+		for (unsigned int i = 0; i < shadowMap.numCascades; i++) {
+			shader.setMat4("_CascadeViewProjections[" + std::to_string(i) + "]", shadowMap.viewProjections[i]);
+			shader.setFloat("_CascadeSplits[" + std::to_string(i) + "]", shadowMap.splits[i]);
+		}
+	}
+
+	void deleteCascadedShadowMap(CascadedShadowMap* shadowMap) {
+		glDeleteFramebuffers(1, &shadowMap->fbo);
+		glDeleteTextures(MAX_SHADOW_CASCADES, shadowMap->layerViews);
+		glDeleteTextures(1, &shadowMap->depthTexture);
+		*shadowMap = CascadedShadowMap();
+	}
+
+	ShadowCache createShadowCache(const CascadedShadowMap& shadowMap) {
+		ShadowCache cache;
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &cache.staticDepthTexture);
+		glTextureStorage3D(cache.staticDepthTexture, 1, GL_DEPTH_COMPONENT32F, shadowMap.resolution, shadowMap.resolution, MAX_SHADOW_CASCADES);
+		glTextureParameteri(cache.staticDepthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(cache.staticDepthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return cache;
+	}
+
+	// Returns true when the static layer has to be drawn again this frame, and records the state it will be drawn with.
+	// Cascades are compared exactly; texel snapping keeps them identical while the camera holds still.
+	bool updateShadowCache(ShadowCache* cache, const CascadedShadowMap& shadowMap, const glm::mat4* staticTransforms, unsigned int numStaticTransforms) {
+		bool stale = !cache->valid || cache->numCascades != shadowMap.numCascades
+			|| cache->staticTransforms.size() != numStaticTransforms
+			|| !std::equal(staticTransforms, staticTransforms + numStaticTransforms, cache->staticTransforms.begin());
+		for (unsigned int i = 0; i < shadowMap.numCascades && !stale; i++) {
+			stale = cache->viewProjections[i] != shadowMap.viewProjections[i];
+		}
+		if (!stale) {
+			cache->numReuses++;
+			return false;
+		}
+		cache->valid = true;
+		cache->numCascades = shadowMap.numCascades;
+		std::copy(shadowMap.viewProjections, shadowMap.viewProjections + MAX_SHADOW_CASCADES, cache->viewProjections);
+		cache->staticTransforms.assign(staticTransforms, staticTransforms + numStaticTransforms);
+		cache->numStaticRenders++;
+		return true;
+	}
+
+	// Overwrites the live cascades with the static layer. Takes the place of clearing the shadow map
+	void copyStaticShadows(const ShadowCache& cache, const CascadedShadowMap& shadowMap) {
+		glCopyImageSubData(cache.staticDepthTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+			shadowMap.depthTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+			shadowMap.resolution, shadowMap.resolution, shadowMap.numCascades);
+	}
+
+	// Forces the next updateShadowCache to redraw, e.g. after static geometry itself changed
+	void invalidateShadowCache(ShadowCache* cache) {
+		cache->valid = false;
+	}
+
+	void deleteShadowCache(ShadowCache* cache) {
+		glDeleteTextures(1, &cache->staticDepthTexture);
+		*cache = ShadowCache();
+	}
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../ew/external/glad.h"
+#include "../ew/camera.h"
+#include "../ew/shader.h"
+#include <glm/glm.hpp>
+#include <vector>
 
 namespace nb {
 	struct ShadowMap {
@@ -11,4 +15,51 @@ namespace nb {
 
 	ShadowMap createShadowMap(unsigned int width, unsigned int height);
 
-}
\ No newline at end of file
+	// Matches MAX_SHADOW_CASCADES in shadowCascades.glsl
+	const unsigned int MAX_SHADOW_CASCADES = 4;
+
+	// Directional light shadows split along the view frustum. Each cascade covers one slice of view depth
+	// and gets its own layer of a GL_TEXTURE_2D_ARRAY, so near geometry gets most of the texels.
+	// All layers are drawn in one pass: shadowCascades.geom sends each triangle to every layer with gl_Layer.
+	struct CascadedShadowMap {
+		unsigned int fbo = 0; // Layered, all cascades attached
+		unsigned int depthTexture = 0; // GL_TEXTURE_2D_ARRAY, one layer per cascade
+		unsigned int layerViews[MAX_SHADOW_CASCADES] = {}; // 2D views of each layer, for debug display
+		unsigned int resolution = 0; // Width and height of every layer
+		unsigned int numCascades = 0;
+		float splitLambda = 0.75f; // Practical split weighting: 0 uniform, 1 logarithmic
+		float casterMargin = 20.0f; // How far toward the light casters outside a cascade's slice are still drawn
+		// Filled by updateShadowCascades
+		float splits[MAX_SHADOW_CASCADES] = {}; // View depth where each cascade ends
+		glm::mat4 viewProjections[MAX_SHADOW_CASCADES];
+		glm::mat4 cameraView = glm::mat4(1.0f);
+		glm::vec3 boundsCenter = glm::vec3(0.0f); // Sphere around every cascade, for culling casters
+		float boundsRadius = 0.0f;
+	};
+
+	CascadedShadowMap createCascadedShadowMap(unsigned int resolution, unsigned int numCascades);
+	void updateShadowCascades(CascadedShadowMap* shadowMap, const ew::Camera& camera, const glm::vec3& lightDirection, float shadowDistance);
+	void setShadowCascadeUniforms(const ew::Shader& shader, const CascadedShadowMap& shadowMap);
+	void deleteCascadedShadowMap(CascadedShadowMap* shadowMap);
+
+	// Depth of the casters that never move, kept between frames in a second array with the cascades' layout.
+	// Each frame the live shadow map starts as a copy of it and only dynamic casters are drawn on top.
+	// The static layer is redrawn when the cascades change or a static transform changes. Cascades change with the light
+	// direction, camera rotation, and camera moves that cross a snapping step (a texel sideways, a quarter cascade radius in depth).
+	struct ShadowCache {
+		unsigned int staticDepthTexture = 0; // GL_TEXTURE_2D_ARRAY, same format and size as the shadow map
+		bool valid = false;
+		// State the static layer was drawn with
+		unsigned int numCascades = 0;
+		glm::mat4 viewProjections[MAX_SHADOW_CASCADES];
+		std::vector<glm::mat4> staticTransforms;
+		unsigned int numStaticRenders = 0;
+		unsigned int numReuses = 0;
+	};
+
+	ShadowCache createShadowCache(const CascadedShadowMap& shadowMap);
+	bool updateShadowCache(ShadowCache* cache, const CascadedShadowMap& shadowMap, const glm::mat4* staticTransforms, unsigned int numStaticTransforms);
+	void copyStaticShadows(const ShadowCache& cache, const CascadedShadowMap& shadowMap);
+	void invalidateShadowCache(ShadowCache* cache);
+	void deleteShadowCache(ShadowCache* cache);
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <ew/external/stb_image.h>
+#include <ew/textureEncoder.h>
+
+static void printUsage() {
+	printf("Usage: texturecompressor <input image> <output.dds> [bc1|bc3|bc5] [--srgb] [--normal] [--nomips]\n");
+	printf("  bc1     RGB, 4 bits per texel (default for images without alpha)\n");
+	printf("  bc3     RGBA, 8 bits per texel (default for images with alpha)\n");
+	printf("  bc5     RG normal maps, 8 bits per texel. Sample with z = sqrt(1 - x*x - y*y)\n");
+	printf("  --srgb  Store as sRGB and filter mips in linear space\n");
+	printf("  --normal  Renormalize mips. Implied by bc5\n");
+	printf("  --nomips  Store only the top level\n");
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+	const char* inputPath = argv[1];
+	const char* outputPath = argv[2];
+	ew::TextureEncodeOptions options;
+	bool formatSet = false;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "bc1") == 0) {
+			options.format = ew::BlockCompression::BC1;
+			formatSet = true;
+		}
+		else if (strcmp(argv[i], "bc3") == 0) {
+			options.format = ew::BlockCompression::BC3;
+			formatSet = true;
+		}
+		else if (strcmp(argv[i], "bc5") == 0) {
+			options.format = ew::BlockCompression::BC5;
+			options.normalMap = true;
+			formatSet = true;
+		}
+		else if (strcmp(argv[i], "--srgb") == 0) {
+			options.srgb = true;
+		}
+		else if (strcmp(argv[i], "--normal") == 0) {
+			options.normalMap = true;
+		}
+		else if (strcmp(argv[i], "--nomips") == 0) {
+			options.mipmap = false;
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			printUsage();
+			return 1;
+		}
+	}
+
+	int width, height, numComponents;
+	unsigned char* pixels = stbi_load(inputPath, &width, &height, &numComponents, 4);
+	if (pixels == NULL) {
+		printf("Failed to load image %s\n", inputPath);
+		return 1;
+	}
+	if (!formatSet) {
+		options.format = numComponents == 4 || numComponents == 2 ? ew::BlockCompression::BC3 : ew::BlockCompression::BC1;
+	}
+	ew::CompressedTextureData texture;
+	bool success = ew::encodeTexture(pixels, width, height, options, &texture);
+	stbi_image_free(pixels);
+	if (!success || !ew::writeDDS(outputPath, texture)) {
+		return 1;
+	}
+	static const char* FORMAT_NAMES[] = { "BC1", "BC3", "BC5", "BC7" };
+	size_t uncompressedSize = (size_t)width * height * 4;
+	printf("%s -> %s: %dx%d %s, %zu levels, %zu bytes (%.1fx smaller than RGBA8 without mips)\n", inputPath, outputPath, width, height,
+		FORMAT_NAMES[(int)options.format], texture.levels.size(), texture.bytes.size(), (double)uncompressedSize / texture.levels[0].size);
+	return 0;
+}